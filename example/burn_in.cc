@@ -130,7 +130,7 @@ int main() {
 
   scheduler<simple_data> sched;
   sched.enqueue_work(simple_data(), std::bind(&controller::run, &c),
-                     op_id("?", "?", 0));
+                     op_id(kUnknownOpName, "?", 0));
 
   sched.run(kWorkerCount);
 
@@ -0,0 +1,61 @@
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+#include "ctx/channel.h"
+#include "ctx/ctx.h"
+
+using namespace ctx;
+
+struct simple_data {
+  void transition(transition, op_id, op_id) {}
+};
+
+int main() {
+  constexpr auto const kCount = 100000;
+
+  scheduler<simple_data> sched;
+  channel<simple_data, int> numbers{64};
+  channel<simple_data, long> squares{64};
+  long sum = 0;
+
+  sched.enqueue_work(
+      simple_data(),
+      [&] {
+        std::vector<int> batch(100);
+        for (auto i = 0; i < kCount; i += batch.size()) {
+          std::iota(begin(batch), end(batch), i);
+          numbers.send_batch(begin(batch), end(batch));
+        }
+        numbers.close();
+      },
+      op_id(CTX_OP_NAME("produce"), "?", 0));
+
+  sched.enqueue_work(
+      simple_data(),
+      [&] {
+        while (auto const n = numbers.receive()) {
+          squares.send(static_cast<long>(*n) * *n);
+        }
+        squares.close();
+      },
+      op_id(CTX_OP_NAME("square"), "?", 0));
+
+  sched.enqueue_work(
+      simple_data(),
+      [&] {
+        for (auto batch = squares.receive_batch(32); !batch.empty();
+             batch = squares.receive_batch(32)) {
+          sum = std::accumulate(begin(batch), end(batch), sum);
+        }
+      },
+      op_id(CTX_OP_NAME("sum"), "?", 0));
+
+  sched.run(4);
+
+  auto expected = 0L;
+  for (auto i = 0L; i < kCount; ++i) {
+    expected += i * i;
+  }
+  std::cout << "sum=" << sum << " expected=" << expected << "\n";
+}
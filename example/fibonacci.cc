@@ -73,7 +73,7 @@ int main() {
   scheduler_t sched;
   for (auto i = 0u; i < kCount; ++i) {
     sched.enqueue_io(simple_data(), std::bind(check, i, expected[i]),
-                     op_id("?", "?", 0));
+                     op_id(kUnknownOpName, "?", 0));
   }
   sched.run(std::thread::hardware_concurrency());
 }
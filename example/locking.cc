@@ -34,22 +34,24 @@ int main() {
 
   access_scheduler<simple_data> c;
   c.emplace_data(0, 0);
+  auto const read_id = op_id(CTX_OP_NAME("read"), "?", 0);
+  auto const write_id = op_id(CTX_OP_NAME("write"), "?", 0);
   for (int i = 0; i < 2000; ++i) {
-    c.enqueue(simple_data{}, read_op, op_id("read", "?", 0), op_type_t::WORK,
+    c.enqueue(simple_data{}, read_op, read_id, op_type_t::WORK,
               {access_request{0U, ctx::access_t::READ}});
-    c.enqueue(simple_data{}, read_op, op_id("read", "?", 0), op_type_t::WORK,
+    c.enqueue(simple_data{}, read_op, read_id, op_type_t::WORK,
               {access_request{0U, ctx::access_t::READ}});
-    c.enqueue(simple_data{}, read_op, op_id("read", "?", 0), op_type_t::WORK,
+    c.enqueue(simple_data{}, read_op, read_id, op_type_t::WORK,
               {access_request{0U, ctx::access_t::READ}});
-    c.enqueue(simple_data{}, read_op, op_id("read", "?", 0), op_type_t::WORK,
+    c.enqueue(simple_data{}, read_op, read_id, op_type_t::WORK,
               {access_request{0U, ctx::access_t::READ}});
-    c.enqueue(simple_data{}, read_op, op_id("read", "?", 0), op_type_t::WORK,
+    c.enqueue(simple_data{}, read_op, read_id, op_type_t::WORK,
               {access_request{0U, ctx::access_t::READ}});
-    c.enqueue(simple_data{}, read_op, op_id("read", "?", 0), op_type_t::WORK,
+    c.enqueue(simple_data{}, read_op, read_id, op_type_t::WORK,
               {access_request{0U, ctx::access_t::READ}});
-    c.enqueue(simple_data{}, read_op, op_id("read", "?", 0), op_type_t::WORK,
+    c.enqueue(simple_data{}, read_op, read_id, op_type_t::WORK,
               {access_request{0U, ctx::access_t::READ}});
-    c.enqueue(simple_data{}, write_op, op_id("write", "?", 0), op_type_t::WORK,
+    c.enqueue(simple_data{}, write_op, write_id, op_type_t::WORK,
               {access_request{0U, ctx::access_t::WRITE}});
   }
 
@@ -57,8 +59,7 @@ int main() {
   c.run(worker_count);
 
   std::cout << data.back() << "\n";
-  std::cout << c.state_.size() << "\n";
-  for (auto const& [id, res] : c.state_) {
+  c.for_each_state([](res_id_t const id, auto const& res) {
     std::cout << "id=" << id << ", usage_count=" << res.usage_count_ << "\n";
-  }
+  });
 }
@@ -33,7 +33,7 @@ int main() {
                                   },
                                   {});
       },
-      op_id("?", "?", 0));
+      op_id(kUnknownOpName, "?", 0));
 
   int worker_count = 8;
   sched.run(worker_count);
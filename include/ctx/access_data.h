@@ -1,14 +1,11 @@
 #pragma once
 
-#include <map>
-
-#include "ctx/access_t.h"
-#include "ctx/res_id_t.h"
+#include "ctx/access_map.h"
 
 namespace ctx {
 
 struct access_data {
-  std::map<res_id_t, access_t> res_access_;
+  access_map res_access_;
 };
 
 }  // namespace ctx
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "ctx/access_t.h"
+#include "ctx/res_id_t.h"
+
+namespace ctx {
+
+// Accesses held by an operation: res_id -> access_t, sorted by res_id.
+// Flat and allocation free for up to kInlineCapacity resources (copied
+// into every child operation), spills to the heap beyond that.
+// Provides the subset of the std::map interface used by the scheduler.
+struct access_map {
+  using value_type = std::pair<res_id_t, access_t>;
+  using iterator = value_type*;
+  using const_iterator = value_type const*;
+
+  static constexpr auto const kInlineCapacity = std::size_t{8U};
+
+  access_map() = default;
+  access_map(access_map const&) = default;
+  access_map& operator=(access_map const&) = default;
+
+  // The source is left empty: a moved-from heap_ must not leave size_
+  // pointing past the inline entries.
+  access_map(access_map&& o) noexcept
+      : inline_{o.inline_},
+        heap_{std::move(o.heap_)},
+        size_{std::exchange(o.size_, 0U)} {
+    o.heap_.clear();
+  }
+
+  access_map& operator=(access_map&& o) noexcept {
+    if (this != &o) {
+      inline_ = o.inline_;
+      heap_ = std::move(o.heap_);
+      size_ = std::exchange(o.size_, 0U);
+      o.heap_.clear();
+    }
+    return *this;
+  }
+
+  ~access_map() = default;
+
+  iterator begin() { return data(); }
+  iterator end() { return data() + size_; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size_; }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0U; }
+
+  iterator find(res_id_t const res_id) {
+    auto const it = lower_bound(res_id);
+    return it != end() && it->first == res_id ? it : end();
+  }
+
+  const_iterator find(res_id_t const res_id) const {
+    return const_cast<access_map*>(this)->find(res_id);
+  }
+
+  // NONE if not held.
+  access_t get(res_id_t const res_id) const {
+    auto const it = find(res_id);
+    return it == end() ? access_t::NONE : it->second;
+  }
+
+  access_t& operator[](res_id_t const res_id) {
+    auto const it = lower_bound(res_id);
+    if (it != end() && it->first == res_id) {
+      return it->second;
+    }
+    return insert(it, value_type{res_id, access_t::NONE})->second;
+  }
+
+  void erase(res_id_t const res_id) {
+    auto const it = find(res_id);
+    if (it == end()) {
+      return;
+    }
+    std::move(it + 1, end(), it);
+    if (spilled()) {
+      heap_.pop_back();
+    }
+    --size_;
+  }
+
+  void clear() {
+    heap_.clear();
+    size_ = 0U;
+  }
+
+private:
+  bool spilled() const { return !heap_.empty(); }
+
+  value_type* data() { return spilled() ? heap_.data() : inline_.data(); }
+  value_type const* data() const {
+    return spilled() ? heap_.data() : inline_.data();
+  }
+
+  iterator lower_bound(res_id_t const res_id) {
+    return std::lower_bound(
+        begin(), end(), res_id,
+        [](value_type const& e, res_id_t const id) { return e.first < id; });
+  }
+
+  iterator insert(iterator const pos, value_type const& v) {
+    auto const idx = static_cast<std::size_t>(pos - begin());
+    if (spilled()) {
+      heap_.insert(heap_.begin() + idx, v);
+    } else if (size_ < kInlineCapacity) {
+      std::move_backward(pos, end(), end() + 1);
+      *pos = v;
+    } else {
+      heap_.reserve(2U * kInlineCapacity);
+      heap_.assign(inline_.begin(), inline_.end());
+      heap_.insert(heap_.begin() + idx, v);
+    }
+    ++size_;
+    return begin() + idx;
+  }
+
+  std::array<value_type, kInlineCapacity> inline_{};
+  std::vector<value_type> heap_;  // all entries once spilled
+  std::size_t size_{0U};
+};
+
+}  // namespace ctx
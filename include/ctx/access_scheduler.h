@@ -1,28 +1,60 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <bitset>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <functional>
-#include <map>
+#include <iterator>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <variant>
 #include <vector>
 
 #include "utl/to_vec.h"
 #include "utl/verify.h"
 
+#include "ctx/access_map.h"
 #include "ctx/access_request.h"
 #include "ctx/access_t.h"
+#include "ctx/cancel_token.h"
 #include "ctx/operation.h"
+#include "ctx/res_handle.h"
 #include "ctx/res_id_t.h"
+#include "ctx/res_stats.h"
 #include "ctx/scheduler.h"
+#include "ctx/versioned.h"
+#include "ctx/wakeup_timer.h"
 
 namespace ctx {
 
 enum class op_type_t : uint8_t { IO, WORK };
 
+// Who gets a contended resource: arriving readers and waiters handed the
+// resource on release.
+//   READER_PREFERENCE: readers join active readers even if writers wait,
+//                      queued readers go before queued writers (default)
+//   WRITER_PREFERENCE: readers wait while a writer waits, queued writers go
+//                      before queued readers (readers may starve)
+//   FIFO:              strict arrival order, consecutive readers share
+//   PHASE_FAIR:        read and write phases alternate: readers wait while a
+//                      writer waits, a writer release admits all waiting
+//                      readers, the last reader admits the next writer
+enum class fairness_policy : uint8_t {
+  READER_PREFERENCE,
+  WRITER_PREFERENCE,
+  FIFO,
+  PHASE_FAIR
+};
+
 template <typename Data, typename = void>
 struct is_access_data : std::false_type {};
 
@@ -38,12 +70,58 @@ template <typename Data>
 struct access_scheduler : public scheduler<Data> {
   static_assert(is_access_state_v<Data>);
 
-  explicit access_scheduler(res_id_t first_generated_res_id = 0)
-      : next_res_id_{first_generated_res_id} {}
+  explicit access_scheduler(
+      res_id_t first_generated_res_id = 0,
+      fairness_policy const policy = fairness_policy::READER_PREFERENCE,
+      bool const resource_affinity = false)
+      : policy_{policy},
+        resource_affinity_{resource_affinity},
+        next_res_id_{first_generated_res_id} {}
+
+  // An operation waiting for its accesses. Accesses are acquired one by one
+  // in ascending resource id order (deadlock free). A release hands the
+  // resource directly to the first waiter(s) of its queue, which then
+  // continue acquiring their remaining resources on the releasing thread.
+  // The waiting operation is resumed only when it holds all of them.
+  //
+  // Lives on the waiting operation's stack. Ownership:
+  //   ACQUIRING: the thread currently advancing it (not queued)
+  //   QUEUED:    the queue it is in (protected by that resource's shard lock)
+  //   GRANTED / ABORTED: the waiting operation (nobody else references it)
+  struct waiter {
+    enum class state : uint8_t { ACQUIRING, QUEUED, GRANTED, ABORTED };
+
+    waiter(operation<Data>* op, op_type_t const type,
+           accesses_t const& access)
+        : op_{op->shared_from_this()}, type_{type}, access_{access} {}
+
+    access_t has(res_id_t const res_id) const {
+      auto const& res_access = op_->data_.res_access_;
+      auto const it = res_access.find(res_id);
+      return it == res_access.end() ? access_t::NONE : it->second;
+    }
 
-  struct queue_entry {
-    op_type_t type_;
     std::shared_ptr<operation<Data>> op_;
+    op_type_t type_;
+    accesses_t const& access_;
+    std::size_t next_{0U};  // access_[0, next_) is granted
+    std::chrono::steady_clock::time_point queued_at_;
+
+    std::mutex mutex_;  // protects state_ and abort_requested_
+    state state_{state::ACQUIRING};
+    bool abort_requested_{false};
+  };
+
+  struct queue_entry {
+    waiter* waiter_;
+    access_t access_;  // mode to grant
+    std::uint64_t seq_;  // arrival order (FIFO policy)
+  };
+
+  // A mutation waiting for the next write combining batch.
+  struct combined_write {
+    std::function<void(void*)> fn_;
+    future_ptr<Data, void> done_;
   };
 
   struct res_state {
@@ -74,8 +152,10 @@ struct access_scheduler : public scheduler<Data> {
 
       ~template_res_holder() override {
         if (!static_cast<res_holder*>(this)->released_) {
-          auto lock = std::lock_guard{scheduler_.lock_};
-          scheduler_.state_.erase(static_cast<res_holder*>(this)->res_id_);
+          auto const res_id = static_cast<res_holder*>(this)->res_id_;
+          auto& shard = scheduler_.get_shard(res_id);
+          auto lock = std::lock_guard{shard.lock_};
+          shard.state_.erase(res_id);
         }
       }
 
@@ -93,14 +173,54 @@ struct access_scheduler : public scheduler<Data> {
 
     bool finished() const {
       return active_writers_ == 0U && active_readers_ == 0U &&  //
-             write_queue_.empty() && read_queue_.empty();
+             active_intent_readers_ == 0U && active_intent_writers_ == 0U &&
+             write_queue_.empty() && read_queue_.empty() &&
+             upgrade_queue_.empty();
     }
 
-    std::vector<queue_entry> write_queue_;
-    std::vector<queue_entry> read_queue_;
+    // Whether `access` is compatible with all active accesses
+    // (not counting own_readers of them: upgrades).
+    bool compatible(access_t const access,
+                    std::size_t const own_readers = 0U) const {
+      auto const readers = active_readers_ - own_readers;
+      switch (access) {
+        case access_t::NONE: return true;
+        case access_t::INTENT_READ: return active_writers_ == 0U;
+        case access_t::INTENT_WRITE:
+          return active_writers_ == 0U && readers == 0U;
+        case access_t::READ:
+          return active_writers_ == 0U && active_intent_writers_ == 0U;
+        case access_t::WRITE:
+          return active_writers_ == 0U && readers == 0U &&
+                 active_intent_readers_ == 0U && active_intent_writers_ == 0U;
+      }
+      return false;
+    }
+
+    void remove(waiter const* w) {
+      for (auto* q : {&write_queue_, &read_queue_, &upgrade_queue_}) {
+        q->erase(std::remove_if(begin(*q), end(*q),
+                                [&](queue_entry const& e) {
+                                  return e.waiter_ == w;
+                                }),
+                 end(*q));
+      }
+    }
+
+    std::deque<queue_entry> write_queue_;
+    std::deque<queue_entry> read_queue_;  // READ and intentions
+    std::deque<queue_entry> upgrade_queue_;  // READ -> WRITE / INTENT_WRITE
+    std::uint64_t next_seq_{0U};
+    res_stats stats_;
+    unsigned last_worker_{runner::kNoWorker};  // resource_affinity
     size_t usage_count_{0U};
     size_t active_readers_{0U};
     size_t active_writers_{0U};
+    size_t active_intent_readers_{0U};
+    size_t active_intent_writers_{0U};
+    std::optional<res_id_t> parent_;  // hierarchical resources
+    std::vector<combined_write> combined_writes_;  // pending batch
+    bool combining_{false};  // a batch operation is enqueued or running
 
     // Memory management
     // =================
@@ -131,202 +251,731 @@ struct access_scheduler : public scheduler<Data> {
     std::weak_ptr<res_holder> weak_;
   };
 
+  // Resource states are distributed over shards by resource id.
+  // Each shard's lock protects its map and all res_states in it, so
+  // operations on resources in different shards do not contend.
+  static constexpr auto const kShardCount = 64U;
+
+  // Cache line aligned: neighbouring shards must not false-share.
+  struct alignas(64) shard {
+    std::mutex lock_;
+    std::unordered_map<res_id_t, res_state> state_;
+  };
+  static_assert(sizeof(shard) % 64U == 0U);
+
+  // The shards of a set of resources, locked in ascending shard order
+  // (deadlock free). BasicLockable: use with std::unique_lock.
+  struct shard_set {
+    shard_set(access_scheduler const& s, accesses_t const& access) : s_{s} {
+      for (access_request const& a : access) {
+        shards_.set(shard_idx(a.res_id_));
+      }
+    }
+
+    void lock() {
+      for (auto i = 0U; i != kShardCount; ++i) {
+        if (shards_.test(i)) {
+          s_.shards_[i].lock_.lock();
+        }
+      }
+    }
+
+    void unlock() {
+      for (auto i = 0U; i != kShardCount; ++i) {
+        if (shards_.test(i)) {
+          s_.shards_[i].lock_.unlock();
+        }
+      }
+    }
+
+    access_scheduler const& s_;
+    std::bitset<kShardCount> shards_;
+  };
+
+  static std::size_t shard_idx(res_id_t const res_id) {
+    return res_id % kShardCount;
+  }
+
+  shard& get_shard(res_id_t const res_id) const {
+    return shards_[shard_idx(res_id)];
+  }
+
+  // Requires the shard of the resource to be locked.
+  res_state& state(res_id_t const res_id) const {
+    return get_shard(res_id).state_.at(res_id);
+  }
+
   struct mutex {
     mutex(access_scheduler& s, op_type_t const op_type, accesses_t access,
           std::vector<
               std::shared_ptr<typename access_scheduler::res_state::res_holder>>
-              locks)
-        : s_{s}, access_{std::move(access)}, locks_{std::move(locks)} {
-      wait_for_access(op_type);
+              locks,
+          deadline_t const deadline = kNoDeadline)
+        : s_{s},
+          access_{normalize(s.with_intentions(std::move(access)))},
+          locks_{std::move(locks)} {
+      wait_for_access(op_type, deadline);
     }
 
-    mutex(access_scheduler& s, op_type_t const op_type, accesses_t access)
-        : mutex{s, op_type, std::move(access), s.lock(access)} {}
+    mutex(access_scheduler& s, op_type_t const op_type, accesses_t access,
+          deadline_t const deadline = kNoDeadline)
+        : mutex{s.lock(access), s, op_type, std::move(access), deadline} {}
 
     mutex(mutex const&) = delete;
-    mutex(mutex&&) = default;
     mutex& operator=(mutex const&) = delete;
-    mutex& operator=(mutex&&) = default;
 
-    ~mutex() { end_access(); }
+    // The source releases nothing: it is left without accesses.
+    mutex(mutex&& o) noexcept
+        : s_{o.s_},
+          access_{std::move(o.access_)},
+          locks_{std::move(o.locks_)},
+          granted_at_{o.granted_at_},
+          res_access_{std::exchange(o.res_access_, nullptr)},
+          prev_access_{std::move(o.prev_access_)} {
+      o.access_.clear();
+      o.locks_.clear();
+    }
+
+    // Not assignable: s_ is a reference and the held grant would have to be
+    // released first.
+    mutex& operator=(mutex&&) = delete;
+
+    ~mutex() { release(access_.size()); }
 
     template <typename T>
     T& get(res_id_t const res_id) {
-      utl::verify(
-          std::any_of(begin(access_), end(access_),
-                      [&](auto const& a) { return a.res_id_ == res_id; }),
-          "resource {} not locked", res_id);
-      return s_.get<T>(res_id);
+      auto const it = std::find_if(
+          begin(locks_), end(locks_),
+          [&](auto const& holder) { return holder->res_id_ == res_id; });
+      utl::verify(it != end(locks_), "resource {} not locked", res_id);
+      return *static_cast<T*>((*it)->get());
+    }
+
+    // Typed handle to the i-th requested resource (request order).
+    // Use res_handle<T const> for resources requested with READ access.
+    template <typename T>
+    res_handle<T> handle(std::size_t const i) {
+      auto const& holder = locks_.at(i);
+      return {static_cast<T*>(holder->get()), holder->res_id_};
     }
 
   private:
-    void wait_for_access(op_type_t const op_type) {
-      auto l = std::unique_lock{s_.lock_, std::defer_lock_t{}};
-      auto const op = current_op<Data>();
+    // Braced initialization evaluates left to right: locks are taken in
+    // request order before the request is moved from.
+    mutex(std::vector<std::shared_ptr<
+              typename access_scheduler::res_state::res_holder>>
+              locks,
+          access_scheduler& s, op_type_t const op_type, accesses_t access,
+          deadline_t const deadline)
+        : mutex{s, op_type, std::move(access), std::move(locks), deadline} {}
 
-      auto const get_existing_access = [&](res_id_t const id) {
-        if (auto const it = op->data_.res_access_.find(id);
-            it != end(op->data_.res_access_)) {
-          return it->second;
+    // Sorted by resource id (acquisition order), one entry per resource.
+    static accesses_t normalize(accesses_t access) {
+      std::sort(begin(access), end(access),
+                [](access_request const& a, access_request const& b) {
+                  return a.res_id_ < b.res_id_;
+                });
+      auto out = begin(access);
+      for (auto it = begin(access); it != end(access); ++it) {
+        if (out != begin(access) && std::prev(out)->res_id_ == it->res_id_) {
+          auto& prev = std::prev(out)->access_;
+          prev = combine(prev, it->access_);
         } else {
-          return access_t::NONE;
+          *out++ = *it;
         }
-      };
-
-      auto const obtain_access = [&]() {
-        for (access_request const& wants : access_) {
-          // case | has already | wants | require
-          // ---- | ------------+-------+---------
-          //    1 | READ        | READ  | -
-          //    2 | WRITE       | *     | -
-          //    3 | READ        | WRITE | active_readers == 1
-          //    4 | NONE        | READ  | active_writers == 0
-          //    5 | NONE        | WRITE | active_writers == active_readers == 0
-          auto const has = get_existing_access(wants.res_id_);
-
-          if (has == access_t::WRITE ||
-              (has == access_t::READ && wants.access_ == access_t::READ)) {
-            // Handles: cases 1, 2
-            continue;
-          } else {
-            auto& res_s = s_.state_.at(wants.res_id_);
-
-            // Handles: case 3 (upgrade READ -> WRITE)
-            if (has == access_t::READ && wants.access_ == access_t::WRITE) {
-              assert(res_s.active_writers_ == 0U);
-              assert(res_s.active_readers_ >= 1U);
-              if (res_s.active_readers_ > 1) {
-                // Other readers -> we need to wait for them to finish.
-                return false;
+      }
+      access.erase(out, end(access));
+      return access;
+    }
+
+    // Throws operation_timeout if access was not granted before the deadline.
+    void wait_for_access(op_type_t const op_type, deadline_t const deadline) {
+      using state = typename waiter::state;
+
+      auto const op = current_op<Data>();
+
+      for (access_request const& a : access_) {
+        auto const it = op->data_.res_access_.find(a.res_id_);
+        auto const has =
+            it == op->data_.res_access_.end() ? access_t::NONE : it->second;
+        utl::verify(!is_intent(has) || is_compatible(has, a.access_),
+                    "resource {}: cannot upgrade intention lock", a.res_id_);
+      }
+
+      {
+        auto shards = shard_set{s_, access_};
+        auto const l = std::lock_guard{shards};
+        for (access_request const& a : access_) {
+          ++s_.state(a.res_id_).usage_count_;
+        }
+      }
+
+      auto w = waiter{op, op_type, access_};
+      if (s_.advance(w) == advance_result::QUEUED) {
+        auto timer = std::optional<wakeup_timer<Data>>{};
+        if (deadline != kNoDeadline) {
+          timer.emplace(deadline);
+        }
+        auto const expired = [&]() { return timer && timer->expired(); };
+
+        while (true) {
+          auto wl = std::unique_lock{w.mutex_};
+          if (w.state_ == state::GRANTED) {
+            break;
+          } else if (w.state_ == state::ABORTED) {
+            wl.unlock();
+            release(w.next_);
+            if (op->is_cancelled()) {
+              throw operation_cancelled{};
+            }
+            throw operation_timeout{};
+          } else if (op->is_cancelled() || expired()) {
+            if (w.state_ == state::QUEUED) {
+              // Leave the queue (lock order: shard -> waiter).
+              // Waiters queued behind us might be admissible now.
+              auto const res_id = access_[w.next_].res_id_;
+              wl.unlock();
+              auto handed = std::vector<waiter*>{};
+              {
+                auto& shard = s_.get_shard(res_id);
+                auto const sl = std::lock_guard{shard.lock_};
+                auto const l = std::lock_guard{w.mutex_};
+                if (w.state_ == state::QUEUED) {
+                  auto& res_s = shard.state_.at(res_id);
+                  res_s.remove(&w);
+                  w.state_ = state::ABORTED;
+                  s_.dispatch(res_s, access_t::NONE, handed);
+                }
               }
+              s_.continue_waiters(handed);
               continue;
             }
 
-            // Handles: cases 4, 5 (no access -> READ or WRITE)
-            if (wants.access_ == access_t::READ) {
-              if (res_s.active_writers_ != 0U) {
-                res_s.read_queue_.emplace_back(
-                    queue_entry{op_type, op->shared_from_this()});
-                return false;
-              }
-            } else {
-              if (res_s.active_writers_ != 0U || res_s.active_readers_ != 0U) {
-                res_s.write_queue_.emplace_back(
-                    queue_entry{op_type, op->shared_from_this()});
-                return false;
-              }
-            }
+            // Being advanced by a releaser: it will report back.
+            w.abort_requested_ = true;
           }
+          wl.unlock();
+
+          op->suspend(/*finish = */ false);
         }
-        return true;
-      };
+      }
 
-      auto const activate = [&]() {
-        for (access_request const& a : access_) {
-          auto& res_access = op->data_.res_access_[a.res_id_];
-          res_access = std::max(a.access_, res_access);
+      res_access_ = &op->data_.res_access_;
+      for (access_request const& a : access_) {
+        auto& res_access = (*res_access_)[a.res_id_];
+        prev_access_[a.res_id_] = res_access;
+        res_access = combine(a.access_, res_access);
+      }
+      granted_at_ = std::chrono::steady_clock::now();
+    }
 
-          auto& res_s = s_.state_.at(a.res_id_);
-          if (a.access_ == access_t::READ) {
-            ++res_s.active_readers_;
+    // Releases access_[0, granted) and the usage counts of all accesses.
+    // Restores the operation's previous accesses (including intention
+    // locks on ancestors) if all were granted: nested mutexes of one
+    // operation have to be released in reverse order.
+    void release(std::size_t const granted) {
+      if (res_access_ != nullptr) {
+        for (auto const& [res_id, prev] : prev_access_) {
+          if (prev == access_t::NONE) {
+            res_access_->erase(res_id);
           } else {
-            ++res_s.active_writers_;
+            (*res_access_)[res_id] = prev;
           }
         }
-      };
+        res_access_ = nullptr;
+      }
 
+      auto const complete = granted == access_.size();
+      auto const hold_time =
+          complete ? std::chrono::steady_clock::now() - granted_at_
+                   : std::chrono::steady_clock::duration{};
+      auto handed = std::vector<waiter*>{};
       {
-        auto const tmp = std::lock_guard{s_.lock_};
-        for (access_request const& a : access_) {
-          ++s_.state_.at(a.res_id_).usage_count_;
+        auto shards = shard_set{s_, access_};
+        auto const l = std::lock_guard{shards};
+        for (auto i = 0U; i != access_.size(); ++i) {
+          auto& res_s = s_.state(access_[i].res_id_);
+          --res_s.usage_count_;
+          if (complete) {
+            res_s.stats_.hold_time_.add(hold_time);
+          }
+          if (i < granted) {
+            res_s.last_worker_ = runner::current_worker();
+            revoke(res_s, access_[i].access_);
+            s_.dispatch(res_s, access_[i].access_, handed);
+          }
         }
       }
+      s_.continue_waiters(handed);
+    }
+
+    access_scheduler& s_;
+    accesses_t access_;
+    std::vector<
+        std::shared_ptr<typename access_scheduler::res_state::res_holder>>
+        locks_;  // request order
+    std::chrono::steady_clock::time_point granted_at_;
+
+    // Accesses of the owning operation before this mutex was granted
+    // (NONE if not held), restored on release.
+    decltype(Data::res_access_)* res_access_{nullptr};
+    access_map prev_access_;
+  };
 
-      while (true) {
-        l.lock();
+  // Calls fn(mutex&) if fn accepts the mutex (to obtain res_handles from),
+  // fn() otherwise.
+  template <typename Fn>
+  static decltype(auto) call_locked(Fn& fn, mutex& lock) {
+    if constexpr (std::is_invocable_v<Fn&, mutex&>) {
+      return fn(lock);
+    } else {
+      (void)lock;
+      return fn();
+    }
+  }
 
-        // Check access.
-        if (obtain_access()) {
-          activate();  // Success - activate.
-          break;
+  ~access_scheduler() {
+    for (auto& shard : shards_) {
+      for (auto const& [id, s] : shard.state_) {
+        if (auto lock = s.weak_.lock(); lock) {
+          lock->released_ = true;
         }
+      }
+    }
+  }
+
+  enum class advance_result { GRANTED, QUEUED, ABORT };
+
+  // Acquires the remaining accesses of w in order until all are granted or
+  // one has to wait (w is queued there). The caller owns w (ACQUIRING).
+  advance_result advance(waiter& w) {
+    for (; w.next_ != w.access_.size(); ++w.next_) {
+      auto const& a = w.access_[w.next_];
+      auto const has = w.has(a.res_id_);
+
+      auto& shard = get_shard(a.res_id_);
+      auto const l = std::lock_guard{shard.lock_};
+      auto& res_s = shard.state_.at(a.res_id_);
+
+      auto const queue = wait_queue(res_s, a.access_, has);
+      if (queue == &res_s.upgrade_queue_) {
+        ++res_s.stats_.upgrade_waits_;
+      }
+      if (queue == nullptr) {
+        grant(res_s, a.access_, has);
+        continue;
+      }
 
-        // Not successful.
-        // Wait until resumed by another operation.
-        l.unlock();
-        op->suspend(/*finish = */ false);
+      auto const wl = std::lock_guard{w.mutex_};
+      if (w.abort_requested_) {
+        return advance_result::ABORT;
       }
+      queue->emplace_back(queue_entry{&w, a.access_, res_s.next_seq_++});
+      w.state_ = waiter::state::QUEUED;
+      w.queued_at_ = std::chrono::steady_clock::now();
+
+      auto& stats = res_s.stats_;
+      ++stats.contended_;
+      if (has == access_t::READ) {
+        ++stats.upgrades_;
+      }
+      stats.max_queue_length_ = std::max(
+          stats.max_queue_length_,
+          static_cast<std::uint64_t>(res_s.read_queue_.size() +
+                                     res_s.write_queue_.size() +
+                                     res_s.upgrade_queue_.size()));
+      return advance_result::QUEUED;
     }
+    return advance_result::GRANTED;
+  }
 
-    void end_access() {
-      auto const l = std::unique_lock{s_.lock_};
-      for (access_request const& a : access_) {
-        auto& res_s = s_.state_.at(a.res_id_);
-        --res_s.usage_count_;
-
-        if (a.access_ == access_t::READ) {
-          --res_s.active_readers_;
-          if (res_s.active_readers_ == 0U && !res_s.write_queue_.empty()) {
-            s_.unqueue(res_s.write_queue_);
-          } else if (!res_s.read_queue_.empty()) {
-            s_.unqueue(res_s.read_queue_);
-          }
+  // The queue an access has to wait in, nullptr if it can be granted.
+  //
+  // case | has already | wants        | require
+  // ---- | ------------+--------------+---------
+  //    1 | covers      | *            | -
+  //    2 | READ        | WRITE / IW   | compatible except own read
+  //    3 | NONE / IR   | R / IR / IW  | compatible, admit_reader
+  //    4 | NONE / IR   | W            | compatible, admit_writer
+  // (IR / IW to an incompatible access is rejected by the mutex.)
+  std::deque<queue_entry>* wait_queue(res_state& res_s, access_t const wants,
+                                      access_t const has) const {
+    if (covers(has, wants)) {
+      // Handles: case 1
+      return nullptr;
+    } else if (has == access_t::READ) {
+      // Handles: case 2 (upgrade)
+      assert(res_s.active_readers_ >= 1U);
+      return res_s.compatible(wants, 1U) ? nullptr : &res_s.upgrade_queue_;
+    } else if (wants != access_t::WRITE) {
+      // Handles: case 3
+      return admit_reader(res_s) && res_s.compatible(wants)
+                 ? nullptr
+                 : &res_s.read_queue_;
+    } else {
+      // Handles: case 4
+      return admit_writer(res_s) && res_s.compatible(wants)
+                 ? nullptr
+                 : &res_s.write_queue_;
+    }
+  }
+
+  static void grant(res_state& res_s, access_t const access,
+                    access_t const has) {
+    if (has == access_t::READ && !covers(has, access)) {
+      ++res_s.stats_.upgrades_;
+    }
+    grant(res_s, access);
+  }
+
+  static void grant(res_state& res_s, access_t const access) {
+    switch (access) {
+      case access_t::READ:
+        ++res_s.active_readers_;
+        ++res_s.stats_.read_acquisitions_;
+        break;
+      case access_t::WRITE:
+        ++res_s.active_writers_;
+        ++res_s.stats_.write_acquisitions_;
+        break;
+      case access_t::INTENT_READ:
+        ++res_s.active_intent_readers_;
+        ++res_s.stats_.intent_acquisitions_;
+        break;
+      case access_t::INTENT_WRITE:
+        ++res_s.active_intent_writers_;
+        ++res_s.stats_.intent_acquisitions_;
+        break;
+      case access_t::NONE: break;
+    }
+  }
+
+  static void revoke(res_state& res_s, access_t const access) {
+    switch (access) {
+      case access_t::READ: --res_s.active_readers_; break;
+      case access_t::WRITE: --res_s.active_writers_; break;
+      case access_t::INTENT_READ: --res_s.active_intent_readers_; break;
+      case access_t::INTENT_WRITE: --res_s.active_intent_writers_; break;
+      case access_t::NONE: break;
+    }
+  }
+
+  // Whether an arriving reader / writer may pass the queues.
+  // (Readers: all non-exclusive accesses, including intentions.)
+  bool admit_reader(res_state const& res_s) const {
+    if (res_s.active_writers_ != 0U) {
+      return false;
+    }
+    switch (policy_) {
+      case fairness_policy::READER_PREFERENCE:
+        return true;
+      case fairness_policy::WRITER_PREFERENCE:
+      case fairness_policy::PHASE_FAIR:
+        return res_s.write_queue_.empty();
+      case fairness_policy::FIFO:
+        return res_s.write_queue_.empty() && res_s.read_queue_.empty();
+    }
+    return true;
+  }
+
+  bool admit_writer(res_state const& res_s) const {
+    return res_s.active_writers_ == 0U && res_s.active_readers_ == 0U &&
+           (policy_ != fairness_policy::FIFO ||
+            (res_s.write_queue_.empty() && res_s.read_queue_.empty()));
+  }
+
+  // Hands the resource to the waiters that can be admitted after `released`
+  // was released (NONE: a waiter left the queue). A waiting upgrade goes
+  // first once only its own read is left, then the fairness policy decides
+  // between the next writer and all compatible queued readers.
+  // Requires the shard of the resource to be locked. The handed waiters have
+  // to be passed to continue_waiters() after unlocking.
+  void dispatch(res_state& res_s, access_t const released,
+                std::vector<waiter*>& handed) {
+    auto now = std::optional<std::chrono::steady_clock::time_point>{};
+    auto const hand_over = [&](queue_entry const& e) {
+      auto const w = e.waiter_;
+      grant(res_s, e.access_);
+      if (!now.has_value()) {
+        now = std::chrono::steady_clock::now();
+      }
+      res_s.stats_.wait_time_.add(*now - w->queued_at_);
+      ++w->next_;
+      {
+        auto const wl = std::lock_guard{w->mutex_};
+        w->state_ = waiter::state::ACQUIRING;
+      }
+      handed.emplace_back(w);
+    };
+    auto const hand_over_front = [&](std::deque<queue_entry>& queue) {
+      hand_over(queue.front());
+      queue.pop_front();
+    };
+    auto const hand_over_writer = [&]() {
+      if (!res_s.write_queue_.empty() &&
+          res_s.compatible(access_t::WRITE)) {
+        hand_over_front(res_s.write_queue_);
+        return true;
+      }
+      return false;
+    };
+    auto const hand_over_readers = [&]() {
+      auto& queue = res_s.read_queue_;
+      if (queue.empty()) {
+        return false;
+      }
+      // In order (a granted INTENT_WRITE blocks the READs behind it),
+      // keeping the blocked entries in place.
+      auto const n = handed.size();
+      auto blocked_end = begin(queue);
+      for (auto it = begin(queue); it != end(queue); ++it) {
+        if (res_s.compatible(it->access_)) {
+          hand_over(*it);
         } else {
-          --res_s.active_writers_;
-          if (!res_s.write_queue_.empty()) {
-            s_.unqueue(res_s.write_queue_);
-          } else if (!res_s.read_queue_.empty()) {
-            s_.unqueue(res_s.read_queue_);
+          *blocked_end++ = *it;
+        }
+      }
+      queue.erase(blocked_end, end(queue));
+      return handed.size() != n;
+    };
+
+    if (res_s.active_writers_ != 0U) {
+      return;
+    }
+    if (!res_s.upgrade_queue_.empty() &&
+        res_s.compatible(res_s.upgrade_queue_.front().access_, 1U)) {
+      hand_over_front(res_s.upgrade_queue_);
+      return;
+    }
+
+    switch (policy_) {
+      case fairness_policy::READER_PREFERENCE:
+        if (!hand_over_readers()) {
+          hand_over_writer();
+        }
+        break;
+
+      case fairness_policy::WRITER_PREFERENCE:
+        if (!hand_over_writer() && res_s.write_queue_.empty()) {
+          hand_over_readers();
+        }
+        break;
+
+      case fairness_policy::FIFO: {
+        auto const reader_first = [&]() {
+          return !res_s.read_queue_.empty() &&
+                 (res_s.write_queue_.empty() ||
+                  res_s.read_queue_.front().seq_ <
+                      res_s.write_queue_.front().seq_);
+        };
+        if (reader_first()) {
+          while (reader_first() &&
+                 res_s.compatible(res_s.read_queue_.front().access_)) {
+            hand_over_front(res_s.read_queue_);
           }
+        } else {
+          hand_over_writer();
         }
+        break;
       }
+
+      case fairness_policy::PHASE_FAIR:
+        if (released == access_t::WRITE && !res_s.read_queue_.empty()) {
+          hand_over_readers();  // write phase -> read phase
+        } else if (!hand_over_writer() && res_s.write_queue_.empty()) {
+          hand_over_readers();
+        }
+        break;
     }
+  }
 
-    access_scheduler& s_;
-    accesses_t access_;
-    std::vector<
-        std::shared_ptr<typename access_scheduler::res_state::res_holder>>
-        locks_;
-  };
+  // Continues the acquisition of waiters handed a resource by dispatch()
+  // and resumes those that hold all their accesses (or have to abort).
+  void continue_waiters(std::vector<waiter*> const& handed) {
+    for (auto const w : handed) {
+      auto const result = advance(*w);
+      if (result == advance_result::QUEUED) {
+        continue;
+      }
 
-  ~access_scheduler() {
-    for (auto const& [id, s] : state_) {
-      if (auto lock = s.weak_.lock(); lock) {
-        lock->released_ = true;
+      // w may be gone as soon as its state is set.
+      auto const op = w->op_;
+      auto const type = w->type_;
+      {
+        auto const wl = std::lock_guard{w->mutex_};
+        w->state_ = result == advance_result::GRANTED ? waiter::state::GRANTED
+                                                      : waiter::state::ABORTED;
+      }
+      if (type == op_type_t::IO) {
+        this->enqueue_io(op);
+      } else if (resource_affinity_) {
+        // This worker just released (and last held) the handed resource.
+        this->enqueue_work(op, runner::current_worker());
+      } else {
+        this->enqueue_work(op);
       }
     }
   }
 
-  void unqueue(std::vector<queue_entry>& queue) {
-    auto& entry = queue.front();
-    entry.type_ == op_type_t::IO ? this->enqueue_io(entry.op_)
-                                 : this->enqueue_work(entry.op_);
-    queue.erase(begin(queue));
+  // Operations that did not get access before the deadline are dropped
+  // without running fn (on_timeout is called instead, if set).
+  template <typename Fn>
+  void enqueue(Data&& d, Fn&& fn, op_id const id, op_type_t const op_type,
+               accesses_t&& access, deadline_t const deadline,
+               std::function<void()> on_timeout = nullptr) {
+    auto locks = lock(access);  // before access is moved from
+    auto const worker = preferred_worker(op_type, access);
+    auto f = [fn = std::forward<Fn>(fn), access = std::move(access),
+              locks = std::move(locks), op_type, deadline,
+              on_timeout = std::move(on_timeout), this]() mutable {
+      auto lock = std::optional<mutex>{};
+      try {
+        lock.emplace(*this, op_type, std::move(access), std::move(locks),
+                     deadline);
+      } catch (operation_timeout const&) {
+        if (on_timeout) {
+          on_timeout();
+        }
+        return;
+      }
+      call_locked(fn, *lock);
+    };
+    enqueue_op(d, std::move(f), id, op_type, worker);
   }
 
   template <typename Fn>
   void enqueue(Data&& d, Fn&& fn, op_id const id, op_type_t const op_type,
                accesses_t&& access) {
-    if (access.empty()) {
-      (op_type == op_type_t::IO)
-          ? this->enqueue_io(d, std::forward<Fn>(fn), id)
-          : this->enqueue_work(d, std::forward<Fn>(fn), id);
+    if constexpr (!std::is_invocable_v<std::decay_t<Fn>&, mutex&>) {
+      if (access.empty()) {
+        (op_type == op_type_t::IO)
+            ? this->enqueue_io(d, std::forward<Fn>(fn), id)
+            : this->enqueue_work(d, std::forward<Fn>(fn), id);
+        return;
+      }
+    }
+    auto locks = lock(access);  // before access is moved from
+    auto const worker = preferred_worker(op_type, access);
+    auto f = [fn = std::forward<Fn>(fn), access = std::move(access),
+              locks = std::move(locks), op_type, this]() mutable {
+      auto lock = mutex{*this, op_type, std::move(access), std::move(locks)};
+      return call_locked(fn, lock);
+    };
+    enqueue_op(d, std::move(f), id, op_type, worker);
+  }
+
+  // Applies the pending combined writes of a resource. Fails them with
+  // operation_cancelled if the batch operation gets dropped before running.
+  // Holds the resource: its state (and queue) outlives the batch.
+  struct combine_batch {
+    combine_batch(access_scheduler& s, res_id_t const res_id)
+        : s_{s}, res_id_{res_id}, holder_{s.get_holder(res_id)} {}
+
+    combine_batch(combine_batch const&) = delete;
+    combine_batch& operator=(combine_batch const&) = delete;
+
+    ~combine_batch() {
+      if (!ran_) {
+        for (auto& w : take(/* last = */ true)) {
+          w.done_->set(std::make_exception_ptr(operation_cancelled{}));
+        }
+      }
+    }
+
+    // Returns whether more writes are pending (for the next batch).
+    bool run(void* res) {
+      ran_ = true;
+      for (auto& w : take(/* last = */ false)) {
+        try {
+          w.fn_(res);
+          w.done_->set();
+        } catch (...) {
+          w.done_->set(std::current_exception());
+        }
+      }
+
+      auto& shard = s_.get_shard(res_id_);
+      auto const lock = std::lock_guard{shard.lock_};
+      auto& res_s = shard.state_.at(res_id_);
+      res_s.combining_ = !res_s.combined_writes_.empty();
+      return res_s.combining_;
+    }
+
+    std::vector<combined_write> take(bool const last) {
+      auto& shard = s_.get_shard(res_id_);
+      auto const lock = std::lock_guard{shard.lock_};
+      auto& res_s = shard.state_.at(res_id_);
+      auto batch = std::vector<combined_write>{};
+      batch.swap(res_s.combined_writes_);
+      if (last) {
+        res_s.combining_ = false;
+      } else {
+        ++res_s.stats_.combined_batches_;
+        res_s.stats_.combined_writes_ += batch.size();
+      }
+      return batch;
+    }
+
+    access_scheduler& s_;
+    res_id_t res_id_;
+    std::shared_ptr<typename res_state::res_holder> holder_;
+    bool ran_{false};
+  };
+
+  template <typename T>
+  void enqueue_combine_batch(Data d, res_id_t const res_id, op_id id) {
+    // Accesses held by the writer that started the batch are not the
+    // batch's: it would be admitted next to that writer's WRITE access.
+    d.res_access_.clear();
+
+    auto batch = std::make_shared<combine_batch>(*this, res_id);
+    auto f = [this, batch, d, res_id, id](mutex& m) {
+      if (batch->run(m.template handle<T>(0).get())) {
+        enqueue_combine_batch<T>(d, res_id, id);
+      }
+    };
+
+    // The batch serves all writers: cancelling (or accounting) the caller
+    // that happened to start it must not affect the others.
+    auto const detached = detached_spawn{};
+    enqueue(std::move(d), std::move(f), id, op_type_t::WORK,
+            accesses_t{access_request{res_id, access_t::WRITE}});
+  }
+
+  // With resource_affinity: the worker that last held the first resource
+  // requested for writing (or the first resource), kNoWorker otherwise.
+  unsigned preferred_worker(op_type_t const op_type,
+                            accesses_t const& access) const {
+    if (!resource_affinity_ || op_type != op_type_t::WORK || access.empty()) {
+      return runner::kNoWorker;
+    }
+    auto const it = std::find_if(
+        begin(access), end(access),
+        [](access_request const& a) { return a.access_ == access_t::WRITE; });
+    auto const res_id = (it == end(access) ? access.front() : *it).res_id_;
+    auto& shard = get_shard(res_id);
+    auto const lock = std::lock_guard{shard.lock_};
+    return shard.state_.at(res_id).last_worker_;
+  }
+
+  void enqueue_op(Data& d, std::function<void()> f, op_id const id,
+                  op_type_t const op_type, unsigned const worker) {
+    if (op_type == op_type_t::IO) {
+      this->enqueue_io(d, std::move(f), id);
+    } else if (worker != runner::kNoWorker) {
+      this->enqueue_work(d, std::move(f), id, worker);
     } else {
-      auto f = [fn = std::forward<Fn>(fn), access = std::move(access),
-                locks = lock(access), op_type, this]() mutable {
-        auto lock = mutex{*this, op_type, std::move(access), std::move(locks)};
-        return fn();
-      };
-      (op_type == op_type_t::IO) ? this->enqueue_io(d, std::move(f), id)
-                                 : this->enqueue_work(d, std::move(f), id);
+      this->enqueue_work(d, std::move(f), id);
     }
   }
 
   std::vector<std::shared_ptr<typename res_state::res_holder>> lock(
       accesses_t const& access) {
     return utl::to_vec(access, [&](access_request const& r) {
-      auto const res_it = state_.find(r.res_id_);
-      utl::verify(res_it != end(state_), "couldn't find resource {}",
+      auto& shard = get_shard(r.res_id_);
+      auto const shard_lock = std::lock_guard{shard.lock_};
+      auto const res_it = shard.state_.find(r.res_id_);
+      utl::verify(res_it != end(shard.state_), "couldn't find resource {}",
                   r.res_id_);
 
       auto const lock = res_it->second.weak_.lock();
@@ -338,47 +987,207 @@ struct access_scheduler : public scheduler<Data> {
 
   template <typename T>
   void emplace_data(ctx::res_id_t const res_id, T&& t) {
-    auto const it = state_.find(res_id);
-    utl::verify(it == end(state_), "{} already in shared_data", res_id);
-    state_.emplace(res_id, res_state{*this, res_id, std::forward<T>(t)});
+    auto& shard = get_shard(res_id);
+    auto const lock = std::lock_guard{shard.lock_};
+    auto const it = shard.state_.find(res_id);
+    utl::verify(it == end(shard.state_), "{} already in shared_data", res_id);
+    shard.state_.emplace(res_id,
+                         res_state{*this, res_id, std::forward<T>(t)});
+  }
+
+  // Adds a read-copy-update resource: writers publish new versions of
+  // versioned<T> (with WRITE access or versioned<T>::update), readers call
+  // pin() on the returned pointer without requesting access, without
+  // locking and without blocking. The pointer keeps the resource alive
+  // (like an operation holding it).
+  template <typename T>
+  versioned_ptr<T> emplace_versioned(ctx::res_id_t const res_id, T t) {
+    emplace_data(res_id, versioned<T>{std::move(t)});
+    return get_versioned<T>(res_id);
+  }
+
+  // Looks up a versioned resource (shard lock): keep the result instead of
+  // calling this for every read.
+  template <typename T>
+  versioned_ptr<T> get_versioned(ctx::res_id_t const res_id) const {
+    auto holder = get_holder(res_id);
+    auto const ptr = static_cast<versioned<T>*>(holder->get());
+    return versioned_ptr<T>{std::move(holder), ptr};
+  }
+
+  // Adds a resource below `parent` (which has to exist and must not be
+  // removed before its children). Accessing it takes the corresponding
+  // intention lock on all its ancestors, so an operation can lock a whole
+  // subtree with a single access to its root.
+  template <typename T>
+  void emplace_data(ctx::res_id_t const res_id, T&& t,
+                    ctx::res_id_t const parent) {
+    utl::verify(includes(parent), "parent {} of {} not in shared_data", parent,
+                res_id);
+    emplace_data(res_id, std::forward<T>(t));
+    {
+      auto& shard = get_shard(res_id);
+      auto const lock = std::lock_guard{shard.lock_};
+      shard.state_.at(res_id).parent_ = parent;
+    }
+    has_hierarchy_ = true;
+  }
+
+  // Adds INTENT_READ / INTENT_WRITE accesses to all ancestors of the
+  // requested resources.
+  accesses_t with_intentions(accesses_t access) const {
+    if (!has_hierarchy_) {
+      return access;
+    }
+    auto const n = access.size();
+    for (auto i = 0U; i != n; ++i) {
+      auto const intent = (access[i].access_ == access_t::WRITE ||
+                           access[i].access_ == access_t::INTENT_WRITE)
+                              ? access_t::INTENT_WRITE
+                              : access_t::INTENT_READ;
+      for (auto parent = this->parent(access[i].res_id_); parent.has_value();
+           parent = this->parent(*parent)) {
+        access.emplace_back(access_request{*parent, intent});
+      }
+    }
+    return access;
+  }
+
+  std::optional<res_id_t> parent(res_id_t const res_id) const {
+    auto& shard = get_shard(res_id);
+    auto const lock = std::lock_guard{shard.lock_};
+    return shard.state_.at(res_id).parent_;
+  }
+
+  // Write combining (group commit) for hot resources: fn(T&) is queued and
+  // applied together with all other mutations queued meanwhile by a single
+  // operation holding WRITE access, instead of each mutation taking the
+  // write lock (and blocking readers) on its own. One batch operation per
+  // resource is enqueued at a time; mutations arriving while it runs go to
+  // the next batch. The future is set when fn was applied (or threw).
+  template <typename T, typename Fn>
+  future_ptr<Data, void> enqueue_combined_write(Data d, res_id_t const res_id,
+                                                Fn&& fn, op_id id) {
+    auto f = std::make_shared<future<Data, void>>(id);
+    auto start_batch = false;
+    {
+      auto& shard = get_shard(res_id);
+      auto const lock = std::lock_guard{shard.lock_};
+      auto& res_s = shard.state_.at(res_id);
+      res_s.combined_writes_.emplace_back(combined_write{
+          [fn = std::forward<Fn>(fn)](void* res) mutable {
+            fn(*static_cast<T*>(res));
+          },
+          f});
+      start_batch = !std::exchange(res_s.combining_, true);
+    }
+    if (start_batch) {
+      enqueue_combine_batch<T>(std::move(d), res_id, std::move(id));
+    }
+    return f;
   }
 
   bool includes(ctx::res_id_t const res_id) const {
-    return state_.find(res_id) != end(state_);
+    auto& shard = get_shard(res_id);
+    auto const lock = std::lock_guard{shard.lock_};
+    return shard.state_.find(res_id) != end(shard.state_);
   }
 
   template <typename T>
   T const& get(ctx::res_id_t const res_id) const {
-    auto const it = state_.find(res_id);
-    utl::verify(it != end(state_), "{} not in shared_data", res_id);
-    return *reinterpret_cast<T const*>(it->second.weak_.lock()->get());
+    return *reinterpret_cast<T const*>(get_holder(res_id)->get());
   }
 
   template <typename T>
   T& get(ctx::res_id_t const res_id) {
-    auto const it = state_.find(res_id);
-    utl::verify(it != end(state_), "{} not in shared_data", res_id);
-    return *reinterpret_cast<T*>(it->second.weak_.lock()->get());
+    return *reinterpret_cast<T*>(get_holder(res_id)->get());
   }
 
   template <typename T>
   T const* find(ctx::res_id_t const res_id) const {
-    auto const it = state_.find(res_id);
-    return it != end(state_)
-               ? reinterpret_cast<T const*>(it->second.weak_.lock()->get())
-               : nullptr;
+    auto holder = std::shared_ptr<typename res_state::res_holder>{};
+    {
+      auto& shard = get_shard(res_id);
+      auto const lock = std::lock_guard{shard.lock_};
+      auto const it = shard.state_.find(res_id);
+      if (it == end(shard.state_)) {
+        return nullptr;
+      }
+      holder = it->second.weak_.lock();
+    }
+    return reinterpret_cast<T const*>(holder->get());
   }
 
   void remove(res_id_t const res_id) {
-    auto const it = state_.find(res_id);
-    utl::verify(it != end(state_), "could not delete resource {}", res_id);
-    it->second.holder_.reset();
+    auto holder = std::shared_ptr<typename res_state::res_holder>{};
+    {
+      auto& shard = get_shard(res_id);
+      auto const lock = std::lock_guard{shard.lock_};
+      auto const it = shard.state_.find(res_id);
+      utl::verify(it != end(shard.state_), "could not delete resource {}",
+                  res_id);
+      holder = std::move(it->second.holder_);
+    }
+    // Might be the last reference: the destructor locks the shard.
+    holder.reset();
+  }
+
+  // Calls fn(res_id, res_state const&) for all resources, shard by shard.
+  template <typename Fn>
+  void for_each_state(Fn&& fn) const {
+    for (auto& shard : shards_) {
+      auto const lock = std::lock_guard{shard.lock_};
+      for (auto const& [id, s] : shard.state_) {
+        fn(id, s);
+      }
+    }
+  }
+
+  // Snapshot of the contention statistics of a resource.
+  res_stats stats(res_id_t const res_id) const {
+    auto& shard = get_shard(res_id);
+    auto const lock = std::lock_guard{shard.lock_};
+    auto const it = shard.state_.find(res_id);
+    utl::verify(it != end(shard.state_), "{} not in shared_data", res_id);
+    return it->second.stats_;
+  }
+
+  // Snapshot of the contention statistics of all resources
+  // (consistent per shard).
+  std::vector<std::pair<res_id_t, res_stats>> stats() const {
+    auto snapshot = std::vector<std::pair<res_id_t, res_stats>>{};
+    for_each_state([&](res_id_t const id, res_state const& s) {
+      snapshot.emplace_back(id, s.stats_);
+    });
+    return snapshot;
+  }
+
+  void reset_stats() {
+    for (auto& shard : shards_) {
+      auto const lock = std::lock_guard{shard.lock_};
+      for (auto& [id, s] : shard.state_) {
+        s.stats_ = res_stats{};
+      }
+    }
   }
 
   res_id_t generate_res_id() { return next_res_id_++; }
 
-  std::mutex lock_;
-  std::map<res_id_t, res_state> state_;
+  // Copies the holder out under the shard lock: releasing the last reference
+  // with the shard locked would deadlock in the holder's destructor.
+  std::shared_ptr<typename res_state::res_holder> get_holder(
+      res_id_t const res_id) const {
+    auto& shard = get_shard(res_id);
+    auto const lock = std::lock_guard{shard.lock_};
+    auto const it = shard.state_.find(res_id);
+    utl::verify(it != end(shard.state_), "{} not in shared_data", res_id);
+    return it->second.weak_.lock();
+  }
+
+  fairness_policy const policy_;
+  bool const resource_affinity_;
+  std::atomic_bool has_hierarchy_{false};
+  mutable std::array<shard, kShardCount> shards_;
   std::atomic<res_id_t> next_res_id_;
 };
 
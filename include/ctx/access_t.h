@@ -1,7 +1,57 @@
-#pragma once
-
-namespace ctx {
-
-enum class access_t { NONE, READ, WRITE };
-
-}  // namespace ctx
+#pragma once
+
+namespace ctx {
+
+// INTENT_READ / INTENT_WRITE are taken automatically on the ancestors of
+// hierarchical resources: they announce READ / WRITE access to descendants.
+//
+// compatible   | IR | IW | R | W
+// -------------+----+----+---+---
+// INTENT_READ  |  y |  y | y | n
+// INTENT_WRITE |  y |  y | n | n
+// READ         |  y |  n | y | n
+// WRITE        |  n |  n | n | n
+enum class access_t { NONE, READ, WRITE, INTENT_READ, INTENT_WRITE };
+
+inline bool is_intent(access_t const a) {
+  return a == access_t::INTENT_READ || a == access_t::INTENT_WRITE;
+}
+
+inline bool is_compatible(access_t const a, access_t const b) {
+  if (a == access_t::NONE || b == access_t::NONE) {
+    return true;
+  } else if (a == access_t::WRITE || b == access_t::WRITE) {
+    return false;
+  } else if (a == b || a == access_t::INTENT_READ ||
+             b == access_t::INTENT_READ) {
+    return true;
+  } else {
+    return false;  // READ vs. INTENT_WRITE
+  }
+}
+
+// The weakest access implying both a and b.
+inline access_t combine(access_t const a, access_t const b) {
+  auto const rank = [](access_t const x) {
+    switch (x) {
+      case access_t::NONE: return 0;
+      case access_t::INTENT_READ: return 1;
+      case access_t::INTENT_WRITE: return 2;
+      case access_t::READ: return 3;
+      case access_t::WRITE: return 4;
+    }
+    return 0;
+  };
+  if ((a == access_t::READ && b == access_t::INTENT_WRITE) ||
+      (a == access_t::INTENT_WRITE && b == access_t::READ)) {
+    return access_t::WRITE;
+  }
+  return rank(a) >= rank(b) ? a : b;
+}
+
+// Whether holding `has` implies `wants`.
+inline bool covers(access_t const has, access_t const wants) {
+  return combine(has, wants) == has;
+}
+
+}  // namespace ctx
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <mutex>
+
+#include "ctx/cancel_token.h"
+#include "ctx/wait_queue.h"
+
+namespace ctx {
+
+// Reusable barrier: arrive_and_wait() suspends until all expected
+// participants of the current phase arrived.
+// A cancelled waiter withdraws its arrival.
+template <typename Data>
+struct barrier {
+  explicit barrier(std::size_t const expected) : expected_{expected} {}
+
+  barrier(barrier const&) = delete;
+  barrier& operator=(barrier const&) = delete;
+
+  void arrive_and_wait() {
+    auto l = std::unique_lock{mutex_};
+    if (++arrived_ == expected_) {
+      complete_phase(l);
+      return;
+    }
+
+    auto w = typename wait_queue<Data>::waiter{};
+    if (!waiters_.wait(l, w)) {
+      --arrived_;
+      throw operation_cancelled{};
+    }
+  }
+
+  // Leaves the barrier: expected is reduced for all following phases.
+  void arrive_and_drop() {
+    auto l = std::unique_lock{mutex_};
+    --expected_;
+    if (arrived_ == expected_) {
+      complete_phase(l);
+    }
+  }
+
+private:
+  void complete_phase(std::unique_lock<std::mutex>& l) {
+    auto wakeups = typename wait_queue<Data>::wakeups_t{};
+    arrived_ = 0U;
+    waiters_.grant_all(wakeups);
+    l.unlock();
+    wait_queue<Data>::wake(wakeups);
+  }
+
+  std::mutex mutex_;
+  wait_queue<Data> waiters_;
+  std::size_t expected_;
+  std::size_t arrived_{0U};
+};
+
+}  // namespace ctx
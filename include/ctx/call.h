@@ -6,11 +6,11 @@
 #define CTX_STRING2(x) CTX_STRING1(x)
 #define CTX_LOCATION __FILE__ ":" CTX_STRING2(__LINE__)
 
-#define ctx_call(data, fn)         \
-  ctx::call<decltype(data)>(       \
-      data, fn,                    \
-      ctx::op_id(                  \
-          "unknown", CTX_LOCATION, \
+#define ctx_call(data, fn)                   \
+  ctx::call<decltype(data)>(                 \
+      data, fn,                              \
+      ctx::op_id(                            \
+          ctx::kUnknownOpName, CTX_LOCATION, \
           reinterpret_cast<operation<decltype(data)>*>(this_op)->id_.index))
 
 namespace ctx {
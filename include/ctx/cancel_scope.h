@@ -0,0 +1,38 @@
+#pragma once
+
+#include <memory>
+
+#include "ctx/cancel_token.h"
+#include "ctx/operation.h"
+
+namespace ctx {
+
+// Groups the operations spawned by the current operation while the scope is
+// alive, so they can be cancelled together without cancelling the current
+// operation itself. Cancelling the current operation still reaches them.
+template <typename Data>
+struct cancel_scope {
+  cancel_scope()
+      : op_{current_op<Data>()},
+        prev_{op_->cancel_scope_},
+        token_{cancel_token::make(&op_->spawn_token())} {
+    op_->cancel_scope_ = token_.get();
+  }
+
+  cancel_scope(cancel_scope const&) = delete;
+  cancel_scope(cancel_scope&&) = delete;
+  cancel_scope& operator=(cancel_scope const&) = delete;
+  cancel_scope& operator=(cancel_scope&&) = delete;
+
+  ~cancel_scope() { op_->cancel_scope_ = prev_; }
+
+  void cancel() { token_->cancel(); }
+  bool is_cancelled() const { return token_->is_cancelled(); }
+
+private:
+  operation<Data>* op_;
+  cancel_token* prev_;
+  std::shared_ptr<cancel_token> token_;
+};
+
+}  // namespace ctx
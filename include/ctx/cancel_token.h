@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ctx {
+
+struct operation_cancelled : public std::exception {
+  char const* what() const noexcept override { return "operation cancelled"; }
+};
+
+// Cancellation state of one operation (or of a cancel_scope).
+// Tokens form a tree mirroring the operation tree: cancelling a token
+// cancels all tokens created below it and wakes their suspended operations.
+struct cancel_token {
+  static std::shared_ptr<cancel_token> make(cancel_token* parent);
+
+  bool is_cancelled() const { return cancelled_.load(); }
+  void cancel();
+
+  // Called (once) on cancellation to resume the suspended owner.
+  void set_waker(std::function<void()> wake);
+
+private:
+  void add_child(std::shared_ptr<cancel_token> const& child);
+
+  std::atomic_bool cancelled_{false};
+  std::mutex mutex_;
+  std::function<void()> wake_;
+  std::vector<std::weak_ptr<cancel_token>> children_;
+};
+
+}  // namespace ctx
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "utl/verify.h"
+
+#include "ctx/cancel_token.h"
+#include "ctx/operation.h"
+
+namespace ctx {
+
+struct channel_closed : public std::exception {
+  char const* what() const noexcept override { return "channel closed"; }
+};
+
+// Bounded FIFO between operations.
+// send() suspends the sending operation while the channel is full,
+// receive() suspends the receiving operation while it is empty.
+// After close(), send() throws channel_closed and receive() drains the
+// remaining elements and then returns std::nullopt.
+template <typename Data, typename T>
+struct channel {
+  explicit channel(std::size_t const capacity) : capacity_{capacity} {
+    utl::verify(capacity != 0U, "channel capacity must not be 0");
+  }
+
+  channel(channel const&) = delete;
+  channel(channel&&) = delete;
+  channel& operator=(channel const&) = delete;
+  channel& operator=(channel&&) = delete;
+
+  ~channel() = default;
+
+  void send(T t) {
+    auto l = std::unique_lock{mutex_};
+    wait(l, senders_, [&]() { return closed_ || buf_.size() < capacity_; });
+    if (closed_) {
+      throw channel_closed{};
+    }
+    buf_.emplace_back(std::move(t));
+    notify(l, receivers_, 1U);
+  }
+
+  // Sends all elements, suspending whenever the channel is full.
+  template <typename It>
+  void send_batch(It first, It const last) {
+    auto l = std::unique_lock{mutex_};
+    while (first != last) {
+      wait(l, senders_, [&]() { return closed_ || buf_.size() < capacity_; });
+      if (closed_) {
+        throw channel_closed{};
+      }
+      auto sent = std::size_t{0U};
+      for (; first != last && buf_.size() < capacity_; ++first, ++sent) {
+        buf_.emplace_back(*first);
+      }
+      notify(l, receivers_, sent);
+      l.lock();
+    }
+  }
+
+  bool try_send(T& t) {
+    auto l = std::unique_lock{mutex_};
+    if (closed_ || buf_.size() >= capacity_) {
+      return false;
+    }
+    buf_.emplace_back(std::move(t));
+    notify(l, receivers_, 1U);
+    return true;
+  }
+
+  std::optional<T> receive() {
+    auto l = std::unique_lock{mutex_};
+    wait(l, receivers_, [&]() { return closed_ || !buf_.empty(); });
+    if (buf_.empty()) {
+      return std::nullopt;
+    }
+    auto t = std::optional<T>{std::move(buf_.front())};
+    buf_.pop_front();
+    notify(l, senders_, 1U);
+    return t;
+  }
+
+  // Receives at least one (unless closed and drained) and at most max
+  // elements.
+  std::vector<T> receive_batch(std::size_t const max) {
+    auto l = std::unique_lock{mutex_};
+    wait(l, receivers_, [&]() { return closed_ || !buf_.empty(); });
+    auto const n = std::min(max, buf_.size());
+    auto batch = std::vector<T>{};
+    batch.reserve(n);
+    for (auto i = 0U; i != n; ++i) {
+      batch.emplace_back(std::move(buf_.front()));
+      buf_.pop_front();
+    }
+    notify(l, senders_, n);
+    return batch;
+  }
+
+  std::optional<T> try_receive() {
+    auto l = std::unique_lock{mutex_};
+    if (buf_.empty()) {
+      return std::nullopt;
+    }
+    auto t = std::optional<T>{std::move(buf_.front())};
+    buf_.pop_front();
+    notify(l, senders_, 1U);
+    return t;
+  }
+
+  void close() {
+    auto l = std::unique_lock{mutex_};
+    closed_ = true;
+    auto waiting = std::move(senders_);
+    waiting.insert(end(waiting), begin(receivers_), end(receivers_));
+    senders_.clear();
+    receivers_.clear();
+    l.unlock();
+    for (auto const& op : waiting) {
+      op->sched_.enqueue_work(op);
+    }
+  }
+
+  bool is_closed() {
+    auto const l = std::lock_guard{mutex_};
+    return closed_;
+  }
+
+  std::size_t size() {
+    auto const l = std::lock_guard{mutex_};
+    return buf_.size();
+  }
+
+  std::size_t capacity() const { return capacity_; }
+
+private:
+  using waiters_t = std::deque<std::shared_ptr<operation<Data>>>;
+
+  template <typename Ready>
+  void wait(std::unique_lock<std::mutex>& l, waiters_t& waiters,
+            Ready&& ready) {
+    auto const op = current_op<Data>();
+    while (!ready()) {
+      if (op->is_cancelled()) {
+        throw operation_cancelled{};
+      }
+
+      waiters.emplace_back(op->shared_from_this());
+      l.unlock();
+      op->suspend(/* finished = */ false);
+      l.lock();
+
+      // Still registered after a spurious wakeup (e.g. cancellation).
+      waiters.erase(
+          std::remove_if(begin(waiters), end(waiters),
+                         [&](auto const& w) { return w.get() == op; }),
+          end(waiters));
+    }
+  }
+
+  // Resumes up to n waiters. Releases the lock.
+  void notify(std::unique_lock<std::mutex>& l, waiters_t& waiters,
+              std::size_t n) {
+    auto wake = std::vector<std::shared_ptr<operation<Data>>>{};
+    for (; n != 0U && !waiters.empty(); --n) {
+      wake.emplace_back(std::move(waiters.front()));
+      waiters.pop_front();
+    }
+    l.unlock();
+    for (auto const& op : wake) {
+      op->sched_.enqueue_work(op);
+    }
+  }
+
+  std::size_t capacity_;
+  std::mutex mutex_;
+  std::deque<T> buf_;
+  waiters_t senders_, receivers_;
+  bool closed_{false};
+};
+
+}  // namespace ctx
@@ -2,30 +2,93 @@
 
 #include <cassert>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <limits>
 #include <mutex>
 #include <optional>
 #include <stack>
+#include <vector>
 
 namespace ctx {
 
+// Items pushed with push_affine(worker, ...) are preferred by that worker:
+// poll(worker) takes its own affine items first (LIFO), then the shared
+// stack. Other workers steal an affine item (oldest first) only if the
+// shared stack is empty and the preferred worker is busy, i.e. not waiting
+// in poll() itself.
 template <typename T>
 struct concurrent_stack {
+  static constexpr auto const kNoWorker = std::numeric_limits<unsigned>::max();
+
+  // Counters (maintained under the lock anyway) and gauges.
+  struct stats {
+    std::uint64_t pushed_{0U};
+    std::uint64_t polled_{0U};
+    std::uint64_t affine_polled_{0U};  // own affine items
+    std::uint64_t steals_{0U};  // other workers' affine items
+    std::uint64_t waits_{0U};  // poll() had to block
+    std::size_t size_{0U};  // queued items (including affine)
+    unsigned workers_{0U};
+    unsigned waiting_workers_{0U};
+  };
+
   void stop() {
     std::lock_guard sync(lock_);
     stop_ = true;
     cv_.notify_all();
   }
 
-  std::optional<T> poll() {
+  std::optional<T> poll(unsigned const worker = kNoWorker) {
     std::unique_lock sync(lock_);
-    cv_.wait(sync, [&]() { return stop_ || !data_.empty(); });
-    if (stop_ && data_.empty()) {
-      return std::nullopt;
+
+    auto const own = [&]() -> std::deque<T>* {
+      return worker < affine_.size() && !affine_[worker].empty()
+                 ? &affine_[worker]
+                 : nullptr;
+    };
+    auto const stealable = [&]() -> std::deque<T>* {
+      for (auto i = 0U; i != affine_.size(); ++i) {
+        if (i != worker && !affine_[i].empty() && !waiting_[i]) {
+          return &affine_[i];
+        }
+      }
+      return nullptr;
+    };
+
+    auto const ready = [&]() {
+      return stop_ || !data_.empty() || own() != nullptr ||
+             stealable() != nullptr;
+    };
+    if (!ready()) {
+      ++stats_.waits_;
+      set_waiting(worker, true);
+      cv_.wait(sync, ready);
+      set_waiting(worker, false);
+    }
+
+    if (auto const q = own(); q != nullptr) {
+      auto r = std::move(q->back());
+      q->pop_back();
+      ++stats_.polled_;
+      ++stats_.affine_polled_;
+      return r;
     } else if (!data_.empty()) {
+      if (worker < affine_.size() && !affine_empty()) {
+        cv_.notify_all();  // we are busy now: our affine items are stealable
+      }
+      ++stats_.polled_;
       return get_and_remove_top();
+    } else if (auto const q = stealable(); q != nullptr) {
+      auto r = std::move(q->front());
+      q->pop_front();
+      ++stats_.polled_;
+      ++stats_.steals_;
+      return r;
     }
 
-    assert(false);
+    // Stopped: what is left belongs to workers that will wake up for it.
+    assert(stop_);
     return std::nullopt;
   }
 
@@ -34,15 +97,32 @@ struct concurrent_stack {
     return data_.size();
   }
 
-  void reset() {
+  stats get_stats() {
+    std::lock_guard sync(lock_);
+    auto s = stats_;
+    s.size_ = data_.size();
+    for (auto const& q : affine_) {
+      s.size_ += q.size();
+    }
+    s.workers_ = static_cast<unsigned>(waiting_.size());
+    for (auto const w : waiting_) {
+      s.waiting_workers_ += w ? 1U : 0U;
+    }
+    return s;
+  }
+
+  void reset(unsigned const worker_count = 0U) {
     std::lock_guard sync(lock_);
     stop_ = false;
+    affine_.resize(worker_count);
+    waiting_.assign(worker_count, false);
   }
 
   template <typename Arg>
   void push(Arg&& f) {
     std::lock_guard sync(lock_);
     data_.emplace_back(std::forward<Arg>(f));
+    ++stats_.pushed_;
     cv_.notify_all();
   }
 
@@ -50,17 +130,50 @@ struct concurrent_stack {
   void push_bottom(Arg&& f) {
     std::lock_guard sync(lock_);
     data_.emplace(begin(data_), std::forward<T>(f));
+    ++stats_.pushed_;
+    cv_.notify_all();
+  }
+
+  // Falls back to push() for unknown workers.
+  template <typename Arg>
+  void push_affine(unsigned const worker, Arg&& f) {
+    std::lock_guard sync(lock_);
+    if (worker < affine_.size()) {
+      affine_[worker].emplace_back(std::forward<Arg>(f));
+    } else {
+      data_.emplace_back(std::forward<Arg>(f));
+    }
+    ++stats_.pushed_;
     cv_.notify_all();
   }
 
   size_t clear() {
     std::lock_guard sync(lock_);
-    auto const size = data_.size();
+    auto size = data_.size();
     data_.clear();
+    for (auto& q : affine_) {
+      size += q.size();
+      q.clear();
+    }
     return size;
   }
 
 private:
+  void set_waiting(unsigned const worker, bool const waiting) {
+    if (worker < waiting_.size()) {
+      waiting_[worker] = waiting;
+    }
+  }
+
+  bool affine_empty() const {
+    for (auto const& q : affine_) {
+      if (!q.empty()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   T get_and_remove_top() {
     auto const r = std::move(data_.back());
     data_.erase(begin(data_) + data_.size() - 1);
@@ -70,7 +183,10 @@ private:
   std::mutex lock_;
   std::condition_variable cv_;
   std::vector<T> data_;
+  std::vector<std::deque<T>> affine_;  // per worker
+  std::vector<bool> waiting_;  // per worker: blocked in poll()
   bool stop_ = false;
+  stats stats_;
 };
 
 }  // namespace ctx
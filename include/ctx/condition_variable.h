@@ -16,6 +16,9 @@ struct condition_variable {
   template <typename Predicate>
   void wait(Predicate pred);
 
+  template <typename Predicate>
+  void wait_uninterruptible(Predicate pred);
+
   void wait();
   void notify();
 
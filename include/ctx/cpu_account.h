@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace ctx {
+
+// CPU time consumed by one operation, measured with the thread CPU clock
+// between ACTIVATE and DEACTIVATE / FIN (so it follows the operation across
+// workers and excludes time other operations ran on the same thread).
+// Accounts form a tree mirroring the operation tree: tree_time() of a root
+// operation bills the whole request, including children still running and
+// children outliving their parent.
+struct cpu_account {
+  // nullptr unless cpu accounting is enabled.
+  static std::shared_ptr<cpu_account> make(
+      std::shared_ptr<cpu_account> const& parent);
+
+  static void enable(bool const on = true) { enabled_flag = on; }
+  static bool enabled() { return enabled_flag.load(std::memory_order_relaxed); }
+
+  // CPU time of the calling thread.
+  static std::chrono::nanoseconds thread_time();
+
+  // Own time, excluding children.
+  std::chrono::nanoseconds self_time() const {
+    return std::chrono::nanoseconds{self_ns_.load()};
+  }
+
+  // Own time plus the time of all descendants.
+  std::chrono::nanoseconds tree_time() const {
+    return std::chrono::nanoseconds{tree_ns_.load()};
+  }
+
+  // Called on the thread running the operation: ACTIVATE / DEACTIVATE, FIN.
+  void start() { started_ = thread_time(); }
+  void stop();
+
+  static std::atomic_bool enabled_flag;
+
+  std::shared_ptr<cpu_account> parent_;
+  std::chrono::nanoseconds started_{0};
+  std::atomic<std::int64_t> self_ns_{0};
+  std::atomic<std::int64_t> tree_ns_{0};
+};
+
+}  // namespace ctx
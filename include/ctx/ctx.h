@@ -3,9 +3,20 @@
 #include "ctx/access_data.h"
 #include "ctx/access_scheduler.h"
 #include "ctx/call.h"
+#include "ctx/cancel_scope.h"
+#include "ctx/cancel_token.h"
+#include "ctx/cpu_account.h"
 #include "ctx/future.h"
 #include "ctx/impl/condition_variable.h"
 #include "ctx/impl/operation.h"
 #include "ctx/impl/scheduler.h"
+#include "ctx/metrics.h"
+#include "ctx/op_latency.h"
 #include "ctx/operation.h"
+#include "ctx/profiler.h"
+#include "ctx/res_handle.h"
+#include "ctx/res_stats.h"
 #include "ctx/scheduler.h"
+#include "ctx/trace.h"
+#include "ctx/tracer.h"
+#include "ctx/versioned.h"
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace ctx {
+
+// Log2 histogram of durations: bucket i counts durations in
+// [2^(i-1), 2^i) nanoseconds (bucket 0: zero), the last bucket is open.
+// Not synchronized: guard it with the lock protecting the measured state.
+struct duration_histogram {
+  static constexpr auto const kBuckets = 40U;  // last bucket: >= ~4.6min
+
+  void add(std::chrono::nanoseconds const d) {
+    auto const ns = static_cast<std::uint64_t>(std::max(
+        d.count(), std::chrono::nanoseconds::rep{0}));
+    ++buckets_[bucket(ns)];
+    ++count_;
+    sum_ns_ += ns;
+    max_ns_ = std::max(max_ns_, ns);
+  }
+
+  void merge(duration_histogram const& o) {
+    for (auto i = 0U; i != kBuckets; ++i) {
+      buckets_[i] += o.buckets_[i];
+    }
+    count_ += o.count_;
+    sum_ns_ += o.sum_ns_;
+    max_ns_ = std::max(max_ns_, o.max_ns_);
+  }
+
+  std::chrono::nanoseconds mean() const {
+    return std::chrono::nanoseconds{count_ == 0U ? 0U : sum_ns_ / count_};
+  }
+
+  // Upper bound of the bucket containing the q-quantile (0 <= q <= 1).
+  std::chrono::nanoseconds quantile(double const q) const {
+    auto const rank = static_cast<std::uint64_t>(q * count_);
+    auto seen = std::uint64_t{0U};
+    for (auto i = 0U; i != kBuckets; ++i) {
+      seen += buckets_[i];
+      if (seen > rank || seen == count_) {
+        return std::chrono::nanoseconds{
+            std::min(i == 0U ? 0U : std::uint64_t{1U} << i, max_ns_)};
+      }
+    }
+    return std::chrono::nanoseconds{max_ns_};
+  }
+
+  static unsigned bucket(std::uint64_t ns) {
+    auto i = 0U;
+    while (ns != 0U && i != kBuckets - 1U) {
+      ns >>= 1U;
+      ++i;
+    }
+    return i;
+  }
+
+  std::array<std::uint64_t, kBuckets> buckets_{};
+  std::uint64_t count_{0U};
+  std::uint64_t sum_ns_{0U};
+  std::uint64_t max_ns_{0U};
+};
+
+}  // namespace ctx
@@ -1,12 +1,16 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <exception>
+#include <memory>
 #include <type_traits>
 
+#include "ctx/cancel_token.h"
 #include "ctx/condition_variable.h"
 #include "ctx/op_id.h"
 #include "ctx/operation.h"
+#include "ctx/wakeup_timer.h"
 
 namespace ctx {
 
@@ -16,7 +20,7 @@ struct future {};
 template <typename Data, typename T>
 struct future<Data, T,
               typename std::enable_if<!std::is_same<T, void>::value>::type> {
-  future(op_id callee) : callee_(std::move(callee)), result_available_(false) {}
+  future(op_id callee) : callee_(callee), result_available_(false) {}
 
   T& val() {
     if (!result_available_) {
@@ -30,6 +34,52 @@ struct future<Data, T,
     return result_;
   }
 
+  // Throws operation_timeout if the result is not available in time.
+  T& val_until(deadline_t const deadline) {
+    if (!wait_until(deadline)) {
+      throw operation_timeout{};
+    }
+    return val();
+  }
+
+  template <typename Rep, typename Period>
+  T& val_for(std::chrono::duration<Rep, Period> const timeout) {
+    return val_until(std::chrono::steady_clock::now() + timeout);
+  }
+
+  // Returns whether the result is available (without rethrowing).
+  bool wait_until(deadline_t const deadline) {
+    if (result_available_ || deadline <= std::chrono::steady_clock::now()) {
+      return result_available_;
+    }
+    auto const timer = wakeup_timer<Data>{deadline};
+    current_op<Data>()->on_transition(transition::SUSPEND, callee_);
+    cv_.wait([&]() { return result_available_.load() || timer.expired(); });
+    current_op<Data>()->on_transition(transition::RESUME);
+    return result_available_;
+  }
+
+  template <typename Rep, typename Period>
+  bool wait_for(std::chrono::duration<Rep, Period> const timeout) {
+    return wait_until(std::chrono::steady_clock::now() + timeout);
+  }
+
+  // Waits for the callee even if the waiting operation gets cancelled.
+  // Does not rethrow the callee's exception (use val() afterwards).
+  void join() {
+    if (!result_available_) {
+      current_op<Data>()->on_transition(transition::SUSPEND, callee_);
+      cv_.wait_uninterruptible([&]() { return result_available_.load(); });
+      current_op<Data>()->on_transition(transition::RESUME);
+    }
+  }
+
+  void cancel() {
+    if (callee_cancel_) {
+      callee_cancel_->cancel();
+    }
+  }
+
   void set(T&& result) {
     result_ = std::move(result);
     result_available_.store(true);
@@ -44,6 +94,7 @@ struct future<Data, T,
 
   T result_;
   op_id callee_;
+  std::shared_ptr<cancel_token> callee_cancel_;
   std::exception_ptr exception_;
   condition_variable<Data> cv_;
   std::atomic_bool result_available_;
@@ -52,7 +103,7 @@ struct future<Data, T,
 template <typename Data, typename T>
 struct future<Data, T,
               typename std::enable_if<std::is_same<T, void>::value>::type> {
-  future(op_id callee) : callee_(std::move(callee)), result_available_(false) {}
+  future(op_id callee) : callee_(callee), result_available_(false) {}
 
   void val() {
     if (!result_available_) {
@@ -65,6 +116,52 @@ struct future<Data, T,
     }
   }
 
+  // Throws operation_timeout if the result is not available in time.
+  void val_until(deadline_t const deadline) {
+    if (!wait_until(deadline)) {
+      throw operation_timeout{};
+    }
+    val();
+  }
+
+  template <typename Rep, typename Period>
+  void val_for(std::chrono::duration<Rep, Period> const timeout) {
+    val_until(std::chrono::steady_clock::now() + timeout);
+  }
+
+  // Returns whether the result is available (without rethrowing).
+  bool wait_until(deadline_t const deadline) {
+    if (result_available_ || deadline <= std::chrono::steady_clock::now()) {
+      return result_available_;
+    }
+    auto const timer = wakeup_timer<Data>{deadline};
+    current_op<Data>()->on_transition(transition::SUSPEND, callee_);
+    cv_.wait([&]() { return result_available_.load() || timer.expired(); });
+    current_op<Data>()->on_transition(transition::RESUME);
+    return result_available_;
+  }
+
+  template <typename Rep, typename Period>
+  bool wait_for(std::chrono::duration<Rep, Period> const timeout) {
+    return wait_until(std::chrono::steady_clock::now() + timeout);
+  }
+
+  // Waits for the callee even if the waiting operation gets cancelled.
+  // Does not rethrow the callee's exception (use val() afterwards).
+  void join() {
+    if (!result_available_) {
+      current_op<Data>()->on_transition(transition::SUSPEND, callee_);
+      cv_.wait_uninterruptible([&]() { return result_available_.load(); });
+      current_op<Data>()->on_transition(transition::RESUME);
+    }
+  }
+
+  void cancel() {
+    if (callee_cancel_) {
+      callee_cancel_->cancel();
+    }
+  }
+
   void set() {
     result_available_.store(true);
     cv_.notify();
@@ -77,6 +174,7 @@ struct future<Data, T,
   }
 
   op_id callee_;
+  std::shared_ptr<cancel_token> callee_cancel_;
   std::exception_ptr exception_;
   condition_variable<Data> cv_;
   std::atomic_bool result_available_;
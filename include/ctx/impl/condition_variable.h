@@ -27,11 +27,27 @@ void condition_variable<Data>::wait(Predicate pred) {
   }
 }
 
+template <typename Data>
+template <typename Predicate>
+void condition_variable<Data>::wait_uninterruptible(Predicate pred) {
+  auto caller_lock = caller_.lock();
+  assert(caller_lock);
+  while (!pred()) {
+    caller_lock->suspend(/* finished = */ false);
+  }
+}
+
 template <typename Data>
 void condition_variable<Data>::wait() {
   auto caller_lock = caller_.lock();
   assert(caller_lock);
+  if (caller_lock->is_cancelled()) {
+    throw operation_cancelled{};
+  }
   caller_lock->suspend(/* finished = */ false);
+  if (caller_lock->is_cancelled()) {
+    throw operation_cancelled{};
+  }
 }
 
 template <typename Data>
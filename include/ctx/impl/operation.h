@@ -2,6 +2,7 @@
 
 #include "ctx/operation.h"
 #include "ctx/scheduler.h"
+#include "ctx/tracer.h"
 
 namespace ctx {
 
@@ -27,7 +28,8 @@ bool is_null(T* x) {
 
 template <typename Data>
 operation<Data>::operation(Data data, std::function<void()> fn,
-                           scheduler<Data>& sched, op_id id)
+                           scheduler<Data>& sched, op_id id,
+                           std::function<void(std::exception_ptr)> on_cancel)
     :
 #ifdef CTX_ENABLE_ASAN
       fake_stack_(nullptr),
@@ -38,14 +40,26 @@ operation<Data>::operation(Data data, std::function<void()> fn,
       data_(data),
       sched_(sched),
       fn_(std::move(fn)),
+      cancel_(cancel_token::make(this_op == nullptr
+                                     ? nullptr
+                                     : &current_op<Data>()->spawn_token())),
+      on_cancel_(std::move(on_cancel)),
+      cpu_(!is_traced_v<Data>
+               ? nullptr
+               : cpu_account::make(this_op == nullptr
+                                       ? nullptr
+                                       : current_op<Data>()->cpu_)),
       running_(false),
       reschedule_(false),
       finished_(false) {
+  op_counters::count(sched_.op_counters_.local().created_);
 }
 
 template <typename Data>
 operation<Data>::~operation() {
-  sched_.stack_manager_.dealloc(stack_);
+  if (stack_.get_stack() != nullptr) {
+    sched_.stack_manager_.dealloc(stack_);
+  }
 }
 
 #ifdef CTX_ENABLE_ASAN
@@ -87,8 +101,25 @@ void operation<Data>::exit_op_finish_switch() {}
 
 template <typename Data>
 void operation<Data>::on_transition(transition t, op_id const& callee) {
-  if (!is_null(data_)) {
-    maybe_deref(data_).transition(t, id_, callee);
+  using tracer = tracer_t<Data>;
+  if constexpr (is_traced_v<Data>) {
+    if (cpu_ != nullptr &&
+        (t == transition::DEACTIVATE || t == transition::FIN)) {
+      cpu_->stop();
+    }
+    if (latency::enabled()) {
+      timing_.on_transition(t, id_, cpu_.get());
+    }
+    if constexpr (std::is_same_v<tracer, data_tracer>) {
+      if (!is_null(data_)) {
+        maybe_deref(data_).transition(t, id_, callee);
+      }
+    } else {
+      tracer::transition(data_, t, id_, callee);
+    }
+    if (cpu_ != nullptr && t == transition::ACTIVATE) {
+      cpu_->start();
+    }
   }
 }
 
@@ -107,14 +138,35 @@ void operation<Data>::resume() {
   }
 
   if (stack_.get_stack() == nullptr) {
+    if (is_cancelled()) {
+      // Cancelled before it ever ran: drop without allocating a stack.
+      on_transition(transition::FIN);
+      op_counters::count(sched_.op_counters_.local().finished_);
+      {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        finished_ = true;
+        running_ = false;
+      }
+      if (on_cancel_) {
+        on_cancel_(std::make_exception_ptr(operation_cancelled{}));
+      }
+      return;
+    }
     init();
+    op_counters::count(sched_.op_counters_.local().started_);
+  } else {
+    op_counters::count(sched_.op_counters_.local().resumed_);
   }
 
+  op_counters::count(sched_.op_counters_.local().activations_);
   on_transition(transition::ACTIVATE);
   this_op = this;
+  profiler::this_fiber = &fiber_;
   enter_op_start_switch();
   auto const t = jump_fcontext(op_ctx_, this);
   exit_op_finish_switch();
+  profiler::this_fiber = nullptr;
+  this_op = nullptr;
 
   op_ctx_ = t.fctx;
   auto const finished = t.data == nullptr;
@@ -133,6 +185,9 @@ void operation<Data>::resume() {
 template <typename Data>
 void operation<Data>::suspend(bool finished) {
   on_transition(finished ? transition::FIN : transition::DEACTIVATE);
+  if (finished) {
+    op_counters::count(sched_.op_counters_.local().finished_);
+  }
   std::shared_ptr<operation<Data>> self =
       finished ? nullptr : this->shared_from_this();
   exit_op_start_switch();
@@ -145,14 +200,37 @@ void operation<Data>::suspend(bool finished) {
 
 template <typename Data>
 void operation<Data>::start() {
-  fn_();
+#ifndef _WIN32
+  // The profiler walks the stack up to here (not into the fcontext entry).
+  fiber_.stack_end_ = __builtin_frame_address(0);
+#endif
+  try {
+    fn_();
+  } catch (operation_cancelled const&) {
+  }
   suspend(true);
 }
 
 template <typename Data>
 void operation<Data>::init() {
   stack_ = sched_.stack_manager_.alloc();
+  fiber_ = {id_.created_at, stack_.get_stack_end(), stack_.get_stack_end()};
   op_ctx_ = make_fcontext(stack_.get_stack(), kStackSize, execute<Data>);
+  cancel_->set_waker([w = this->weak_from_this()]() {
+    if (auto const op = w.lock(); op) {
+      op->sched_.enqueue_work(op);
+    }
+  });
+}
+
+template <typename Data>
+bool operation<Data>::is_cancelled() const {
+  return cancel_->is_cancelled();
+}
+
+template <typename Data>
+cancel_token& operation<Data>::spawn_token() {
+  return cancel_scope_ != nullptr ? *cancel_scope_ : *cancel_;
 }
 
 }  // namespace ctx
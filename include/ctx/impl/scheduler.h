@@ -14,17 +14,20 @@ template <typename Fn>
 auto scheduler<Data>::post_io(Data d, Fn fn, op_id id) {
   id.index = ++next_id_;
   auto f = std::make_shared<future<Data, decltype(fn())>>(id);
-  enqueue_io(std::forward<Data>(d), std::function<void()>([fn, f]() {
-               std::exception_ptr ex;
-               try {
-                 f->set(fn());
-                 return;
-               } catch (...) {
-                 ex = std::current_exception();
-               }
-               f->set(ex);
-             }),
-             std::move(id));
+  auto op = std::make_shared<operation<Data>>(
+      std::forward<Data>(d), std::function<void()>([fn, f]() {
+        std::exception_ptr ex;
+        try {
+          f->set(fn());
+          return;
+        } catch (...) {
+          ex = std::current_exception();
+        }
+        f->set(ex);
+      }),
+      *this, std::move(id), [f](std::exception_ptr ex) { f->set(ex); });
+  f->callee_cancel_ = op->cancel_;
+  enqueue_io(op);
   return f;
 }
 
@@ -33,18 +36,21 @@ template <typename Fn>
 future_ptr<Data, void> scheduler<Data>::post_void_io(Data d, Fn fn, op_id id) {
   id.index = ++next_id_;
   auto f = std::make_shared<future<Data, void>>(id);
-  enqueue_io(std::forward<Data>(d), std::function<void()>([fn, f]() {
-               std::exception_ptr ex;
-               try {
-                 fn();
-                 f->set();
-                 return;
-               } catch (...) {
-                 ex = std::current_exception();
-               }
-               f->set(ex);
-             }),
-             std::move(id));
+  auto op = std::make_shared<operation<Data>>(
+      std::forward<Data>(d), std::function<void()>([fn, f]() {
+        std::exception_ptr ex;
+        try {
+          fn();
+          f->set();
+          return;
+        } catch (...) {
+          ex = std::current_exception();
+        }
+        f->set(ex);
+      }),
+      *this, std::move(id), [f](std::exception_ptr ex) { f->set(ex); });
+  f->callee_cancel_ = op->cancel_;
+  enqueue_io(op);
   return f;
 }
 
@@ -53,17 +59,20 @@ template <typename Fn>
 auto scheduler<Data>::post_work(Data d, Fn fn, op_id id) {
   id.index = ++next_id_;
   auto f = std::make_shared<future<Data, decltype(fn())>>(id);
-  enqueue_work(std::forward<Data>(d), std::function<void()>([fn, f]() {
-                 std::exception_ptr ex;
-                 try {
-                   f->set(fn());
-                   return;
-                 } catch (...) {
-                   ex = std::current_exception();
-                 }
-                 f->set(ex);
-               }),
-               std::move(id));
+  auto op = std::make_shared<operation<Data>>(
+      std::forward<Data>(d), std::function<void()>([fn, f]() {
+        std::exception_ptr ex;
+        try {
+          f->set(fn());
+          return;
+        } catch (...) {
+          ex = std::current_exception();
+        }
+        f->set(ex);
+      }),
+      *this, std::move(id), [f](std::exception_ptr ex) { f->set(ex); });
+  f->callee_cancel_ = op->cancel_;
+  enqueue_work(op);
   return f;
 }
 
@@ -73,21 +82,58 @@ future_ptr<Data, void> scheduler<Data>::post_void_work(Data d, Fn fn,
                                                        op_id id) {
   id.index = ++next_id_;
   auto f = std::make_shared<future<Data, void>>(id);
-  enqueue_work(std::forward<Data>(d), std::function<void()>([fn, f]() {
-                 std::exception_ptr ex;
-                 try {
-                   fn();
-                   f->set();
-                   return;
-                 } catch (...) {
-                   ex = std::current_exception();
-                 }
-                 f->set(ex);
-               }),
-               std::move(id));
+  auto op = std::make_shared<operation<Data>>(
+      std::forward<Data>(d), std::function<void()>([fn, f]() {
+        std::exception_ptr ex;
+        try {
+          fn();
+          f->set();
+          return;
+        } catch (...) {
+          ex = std::current_exception();
+        }
+        f->set(ex);
+      }),
+      *this, std::move(id), [f](std::exception_ptr ex) { f->set(ex); });
+  f->callee_cancel_ = op->cancel_;
+  enqueue_work(op);
   return f;
 }
 
+template <typename Data>
+ctx::metrics scheduler<Data>::metrics() {
+  auto m = ctx::metrics{};
+  for (auto const& s : op_counters_.slots_) {
+    m.ops_created_ += s.created_.load(std::memory_order_relaxed);
+    m.ops_started_ += s.started_.load(std::memory_order_relaxed);
+    m.ops_finished_ += s.finished_.load(std::memory_order_relaxed);
+    m.context_switches_ += s.activations_.load(std::memory_order_relaxed);
+    m.ops_resumed_ += s.resumed_.load(std::memory_order_relaxed);
+  }
+
+  auto const w = runner_.work_stats();
+  m.tasks_posted_ = w.pushed_;
+  m.tasks_executed_ = w.polled_;
+  m.affine_tasks_executed_ = w.affine_polled_;
+  m.steals_ = w.steals_;
+  m.worker_waits_ = w.waits_;
+  m.queue_depth_ = w.size_;
+  m.tasks_in_system_ = runner_.elements_in_system();
+  m.workers_ = w.workers_;
+  m.idle_workers_ = w.waiting_workers_;
+
+  auto const& st = stack_manager_;
+  m.stacks_allocated_ = st.allocated_.load(std::memory_order_relaxed);
+  m.stacks_reused_ = st.reused_.load(std::memory_order_relaxed);
+  m.stacks_released_ = st.released_.load(std::memory_order_relaxed);
+  m.stacks_pooled_ = st.pooled_.load(std::memory_order_relaxed);
+  auto const taken = m.stacks_allocated_ + m.stacks_reused_;
+  m.stacks_in_use_ =
+      taken > m.stacks_released_ ? taken - m.stacks_released_ : 0U;
+  m.stack_bytes_ = (m.stacks_in_use_ + m.stacks_pooled_) * kStackSize;
+  return m;
+}
+
 template <typename Data>
 void scheduler<Data>::enqueue_io(Data d, std::function<void()> fn, op_id id) {
   id.index = ++next_id_;
@@ -114,4 +160,20 @@ void scheduler<Data>::enqueue_work(std::shared_ptr<operation<Data>> const& op) {
   runner_.post_high_prio([op]() { op->resume(); });
 }
 
+template <typename Data>
+void scheduler<Data>::enqueue_work(Data d, std::function<void()> fn, op_id id,
+                                   unsigned const worker) {
+  id.index = ++next_id_;
+  enqueue_work(std::make_shared<operation<Data>>(
+                   std::forward<Data>(d), std::move(fn), *this, std::move(id)),
+               worker);
+}
+
+template <typename Data>
+void scheduler<Data>::enqueue_work(std::shared_ptr<operation<Data>> const& op,
+                                   unsigned const worker) {
+  op->on_transition(transition::ENQUEUE);
+  runner_.post_affine(worker, [op]() { op->resume(); });
+}
+
 }  // namespace ctx
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cassert>
+#include <mutex>
+
+#include "ctx/cancel_token.h"
+#include "ctx/wait_queue.h"
+
+namespace ctx {
+
+// Single use countdown: wait() suspends until the count reaches zero.
+template <typename Data>
+struct latch {
+  explicit latch(std::size_t const count) : count_{count} {}
+
+  latch(latch const&) = delete;
+  latch& operator=(latch const&) = delete;
+
+  void count_down(std::size_t const n = 1U) {
+    auto wakeups = typename wait_queue<Data>::wakeups_t{};
+    {
+      auto const l = std::lock_guard{mutex_};
+      assert(count_ >= n);
+      count_ -= n;
+      if (count_ == 0U) {
+        waiters_.grant_all(wakeups);
+      }
+    }
+    wait_queue<Data>::wake(wakeups);
+  }
+
+  bool try_wait() {
+    auto const l = std::lock_guard{mutex_};
+    return count_ == 0U;
+  }
+
+  void wait() {
+    auto l = std::unique_lock{mutex_};
+    if (count_ == 0U) {
+      return;
+    }
+    auto w = typename wait_queue<Data>::waiter{};
+    if (!waiters_.wait(l, w)) {
+      throw operation_cancelled{};
+    }
+  }
+
+  void arrive_and_wait(std::size_t const n = 1U) {
+    count_down(n);
+    wait();
+  }
+
+private:
+  std::mutex mutex_;
+  wait_queue<Data> waiters_;
+  std::size_t count_;
+};
+
+}  // namespace ctx
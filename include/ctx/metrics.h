@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <string_view>
+
+#include "ctx/thread_local.h"
+
+namespace ctx {
+
+extern CTX_ATTRIBUTE_TLS unsigned this_worker;
+
+// Operation life cycle counters of one scheduler, one cache line per
+// runner worker (slot 0: other threads and workers beyond kSlots - 1), so
+// counting does not contend.
+struct op_counters {
+  static constexpr auto const kSlots = 64U;
+
+  struct alignas(64) slot {
+    std::atomic<std::uint64_t> created_{0U};
+    std::atomic<std::uint64_t> started_{0U};  // first activation
+    std::atomic<std::uint64_t> activations_{0U};  // switches into an op
+    std::atomic<std::uint64_t> resumed_{0U};  // activations after the first
+    std::atomic<std::uint64_t> finished_{0U};
+  };
+
+  slot& local() {
+    auto const w = this_worker;
+    return slots_[w < kSlots - 1U ? w + 1U : 0U];
+  }
+
+  static void count(std::atomic<std::uint64_t>& c) {
+    c.fetch_add(1U, std::memory_order_relaxed);
+  }
+
+  std::array<slot, kSlots> slots_;
+};
+
+// Point in time view of a scheduler (see scheduler::metrics()).
+// Counters are monotonic; gauges are sampled without stopping the
+// scheduler and therefore only approximately consistent with each other.
+struct metrics {
+  // Operations.
+  std::uint64_t ops_created_{0U};
+  std::uint64_t ops_started_{0U};
+  std::uint64_t ops_finished_{0U};
+  std::uint64_t context_switches_{0U};  // activations (switches into ops)
+  std::uint64_t ops_resumed_{0U};  // activations after a suspension
+
+  // Runner.
+  std::uint64_t tasks_posted_{0U};
+  std::uint64_t tasks_executed_{0U};
+  std::uint64_t affine_tasks_executed_{0U};  // by the preferred worker
+  std::uint64_t steals_{0U};  // affine tasks taken by another worker
+  std::uint64_t worker_waits_{0U};  // worker blocked on an empty queue
+  std::uint64_t queue_depth_{0U};  // gauge
+  std::uint64_t tasks_in_system_{0U};  // gauge: queued or executing
+  std::uint64_t workers_{0U};  // gauge
+  std::uint64_t idle_workers_{0U};  // gauge
+
+  // Fiber stacks.
+  std::uint64_t stacks_allocated_{0U};  // malloc'd
+  std::uint64_t stacks_reused_{0U};  // taken from the pool
+  std::uint64_t stacks_released_{0U};
+  std::uint64_t stacks_pooled_{0U};  // gauge
+  std::uint64_t stacks_in_use_{0U};  // gauge
+  std::uint64_t stack_bytes_{0U};  // gauge: in use + pooled
+};
+
+// Prometheus text exposition format (version 0.0.4).
+void write_prometheus(std::ostream&, metrics const&,
+                      std::string_view prefix = "ctx_");
+
+}  // namespace ctx
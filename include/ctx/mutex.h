@@ -0,0 +1,59 @@
+#pragma once
+
+#include <mutex>
+
+#include "ctx/cancel_token.h"
+#include "ctx/wait_queue.h"
+
+namespace ctx {
+
+// Mutex for operations: lock() suspends the operation instead of blocking
+// the worker thread. unlock() hands the mutex directly to the next waiter.
+// Works with std::lock_guard / std::unique_lock.
+template <typename Data>
+struct mutex {
+  mutex() = default;
+  mutex(mutex const&) = delete;
+  mutex& operator=(mutex const&) = delete;
+
+  void lock() {
+    auto l = std::unique_lock{mutex_};
+    if (!locked_) {
+      locked_ = true;
+      return;
+    }
+    auto w = typename wait_queue<Data>::waiter{};
+    if (!waiters_.wait(l, w)) {
+      throw operation_cancelled{};
+    }
+  }
+
+  bool try_lock() {
+    auto const l = std::lock_guard{mutex_};
+    if (locked_) {
+      return false;
+    }
+    locked_ = true;
+    return true;
+  }
+
+  void unlock() {
+    auto wakeups = typename wait_queue<Data>::wakeups_t{};
+    {
+      auto const l = std::lock_guard{mutex_};
+      if (waiters_.empty()) {
+        locked_ = false;
+      } else {
+        waiters_.grant_front(wakeups);
+      }
+    }
+    wait_queue<Data>::wake(wakeups);
+  }
+
+private:
+  std::mutex mutex_;
+  wait_queue<Data> waiters_;
+  bool locked_{false};
+};
+
+}  // namespace ctx
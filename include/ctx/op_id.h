@@ -1,18 +1,56 @@
 #pragma once
 
-#include <string>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
 
 namespace ctx {
 
+// Interned operation name: index into a global, append-only name table.
+// Interned names are never freed: use them for operation types / call
+// sites, not for per-request strings.
+using op_name_t = std::uint32_t;
+
+constexpr auto const kUnknownOpName = op_name_t{0U};  // "unknown"
+
+// Thread safe. Returns the same id for equal strings.
+op_name_t intern_op_name(std::string_view name);
+
+// Stable pointer to the interned (null terminated) name.
+char const* op_name_str(op_name_t name);
+
+// Interns a name once per call site (function-local static):
+//   op_id(CTX_OP_NAME("load"), CTX_LOCATION, parent_index)
+// Spawn paths should use this instead of the string_view constructor.
+#define CTX_OP_NAME(name)                                   \
+  ([]() -> ctx::op_name_t {                                 \
+    static auto const interned = ctx::intern_op_name(name); \
+    return interned;                                        \
+  }())
+
 struct op_id {
   op_id() = default;
+
+  // Unnamed (kUnknownOpName): created_at identifies the call site.
   op_id(char const* created_at)
-      : name(created_at), created_at(created_at), parent_index(0), index(0) {}
-  op_id(std::string name, char const* created_at, int parent_index)
-      : name(std::move(name)),
+      : name(kUnknownOpName),
+        created_at(created_at),
+        parent_index(0),
+        index(0) {}
+
+  // Slow path: interns the name on every call (global lock + hash).
+  op_id(std::string_view name, char const* created_at, int parent_index)
+      : name(intern_op_name(name)),
         created_at(created_at),
         parent_index(parent_index),
         index(0) {}
+  op_id(op_name_t name, char const* created_at, unsigned parent_index)
+      : name(name),
+        created_at(created_at),
+        parent_index(parent_index),
+        index(0) {}
+
+  char const* name_str() const { return op_name_str(name); }
 
   friend bool operator<(op_id const& lhs, op_id const& rhs) {
     return lhs.index < rhs.index;
@@ -22,10 +60,12 @@ struct op_id {
     return lhs.index == rhs.index;
   }
 
-  std::string name;
-  char const* created_at;
+  op_name_t name{kUnknownOpName};
+  char const* created_at{nullptr};
   unsigned parent_index{0};
   unsigned index{0};
 };
 
+static_assert(std::is_trivially_copyable_v<op_id>);
+
 }  // namespace ctx
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "ctx/cpu_account.h"
+#include "ctx/duration_histogram.h"
+#include "ctx/op_id.h"
+#include "ctx/transition.h"
+
+namespace ctx {
+
+// Where the operations created at one call site spent their time,
+// one sample per finished operation:
+//  - queue_time_: enqueued until activated (runner queue)
+//  - run_time_: activated until deactivated / finished (on a worker)
+//  - suspended_time_: deactivated until enqueued again (waiting for
+//    futures, resources, timers, ...)
+//  - cpu_time_: thread CPU time (only if cpu_account::enabled())
+struct op_latency {
+  std::string name_;
+  duration_histogram queue_time_;
+  duration_histogram run_time_;
+  duration_histogram suspended_time_;
+  duration_histogram cpu_time_;
+};
+
+namespace latency {
+
+extern std::atomic_bool enabled_flag;
+
+inline void enable(bool const on = true) { enabled_flag = on; }
+inline bool enabled() { return enabled_flag.load(std::memory_order_relaxed); }
+
+// Merged over all threads, keyed by op_id::created_at.
+std::map<std::string, op_latency> snapshot();
+
+void reset();
+
+// Adds the samples of one finished operation (calling thread's collector).
+void record(op_id const&, std::chrono::nanoseconds queue,
+            std::chrono::nanoseconds run, std::chrono::nanoseconds suspended,
+            cpu_account const*);
+
+}  // namespace latency
+
+// Per operation accounting, driven by operation::on_transition.
+// ACTIVATE / DEACTIVATE / FIN are serialized by the operation's running_
+// flag; ENQUEUE can race with them (wake-up before the waiter deactivated)
+// and only publishes its timestamp.
+struct op_timing {
+  using clock = std::chrono::steady_clock;
+
+  void on_transition(transition const t, op_id const& id,
+                     cpu_account const* cpu) {
+    auto const now = now_ns();
+    switch (t) {
+      case transition::ENQUEUE: {
+        auto expected = std::int64_t{0};
+        enqueued_at_.compare_exchange_strong(expected, now);
+        break;
+      }
+
+      case transition::ACTIVATE: {
+        auto const enqueued = enqueued_at_.exchange(0);
+        if (enqueued != 0) {
+          if (deactivated_at_ != 0 && enqueued > deactivated_at_) {
+            suspended_ += enqueued - deactivated_at_;
+          }
+          queue_ += now - std::max(enqueued, deactivated_at_);
+        }
+        deactivated_at_ = 0;
+        activated_at_ = now;
+        break;
+      }
+
+      case transition::DEACTIVATE:
+        if (activated_at_ != 0) {
+          run_ += now - activated_at_;
+        }
+        activated_at_ = 0;
+        deactivated_at_ = now;
+        break;
+
+      case transition::FIN:
+        if (activated_at_ != 0) {
+          run_ += now - activated_at_;
+        } else if (auto const enqueued = enqueued_at_.load();
+                   enqueued != 0) {
+          queue_ += now - enqueued;  // cancelled before the first activation
+        } else {
+          break;  // untracked: accounting enabled after the last activation
+        }
+        latency::record(id, std::chrono::nanoseconds{queue_},
+                        std::chrono::nanoseconds{run_},
+                        std::chrono::nanoseconds{suspended_}, cpu);
+        break;
+
+      case transition::SUSPEND:
+      case transition::RESUME: break;
+    }
+  }
+
+  static std::int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               clock::now().time_since_epoch())
+        .count();
+  }
+
+  std::atomic<std::int64_t> enqueued_at_{0};
+  std::int64_t activated_at_{0};
+  std::int64_t deactivated_at_{0};
+  std::int64_t queue_{0};
+  std::int64_t run_{0};
+  std::int64_t suspended_{0};
+};
+
+}  // namespace ctx
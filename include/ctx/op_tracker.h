@@ -1,12 +1,15 @@
 #pragma once
 
 #include <atomic>
+#include <cassert>
+#include <cstdio>
 #include <map>
 #include <mutex>
 
 #include "boost/lockfree/queue.hpp"
 
 #include "ctx/op_id.h"
+#include "ctx/transition.h"
 
 namespace ctx {
 
@@ -79,7 +82,7 @@ struct op_tracker {
 
     printf("STATE:\n");
     for (auto const& op : status_) {
-      printf("%010u\t%s\t%s|%s\t%s\t%s\n", op.first.index, op.first.name,
+      printf("%010u\t%s\t%s|%s\t%s\t%s\n", op.first.index, op.first.name_str(),
              op.second.get_client_state(), op.second.get_operation_state(),
              op.first.created_at, op.second.waiting_for());
     }
@@ -1,17 +1,24 @@
 #pragma once
 
 #include <cinttypes>
+#include <exception>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <utility>
 
 #include "boost/context/detail/fcontext.hpp"
 
 #include "ctx/access_t.h"
+#include "ctx/cancel_token.h"
+#include "ctx/cpu_account.h"
 #include "ctx/op_id.h"
+#include "ctx/op_latency.h"
+#include "ctx/profiler.h"
 #include "ctx/res_id_t.h"
 #include "ctx/stack_manager.h"
 #include "ctx/thread_local.h"
+#include "ctx/transition.h"
 #include "ctx_config.h"
 
 #ifdef CTX_ENABLE_ASAN
@@ -33,11 +40,10 @@ using boost::context::detail::jump_fcontext;
 template <typename Data>
 struct scheduler;
 
-enum class transition { RESUME, SUSPEND, ENQUEUE, ACTIVATE, DEACTIVATE, FIN };
-
 template <typename Data>
 struct operation : public std::enable_shared_from_this<operation<Data>> {
-  operation(Data, std::function<void()>, scheduler<Data>&, op_id);
+  operation(Data, std::function<void()>, scheduler<Data>&, op_id,
+            std::function<void(std::exception_ptr)> on_cancel = nullptr);
   ~operation();
 
   void enter_op_start_switch();
@@ -52,6 +58,9 @@ struct operation : public std::enable_shared_from_this<operation<Data>> {
   void init();
   intptr_t me() const;
 
+  bool is_cancelled() const;
+  cancel_token& spawn_token();
+
 #ifdef CTX_ENABLE_ASAN
   void* fake_stack_;
   void const* bottom_old_;
@@ -62,12 +71,28 @@ struct operation : public std::enable_shared_from_this<operation<Data>> {
   Data data_;
 
   stack_handle stack_;
+  profiler::fiber fiber_{};
   fcontext_t op_ctx_;
   fcontext_t main_ctx_;
 
   scheduler<Data>& sched_;
   std::function<void()> fn_;
 
+  // cancel_ is checked at suspension points and before the first activation.
+  // Operations spawned by this one register below cancel_scope_ (if a
+  // cancel_scope is active) or cancel_.
+  // on_cancel_ reports cancellation of an operation that never started.
+  std::shared_ptr<cancel_token> cancel_;
+  cancel_token* cancel_scope_{nullptr};
+  std::function<void(std::exception_ptr)> on_cancel_;
+
+  // Queue / run / suspended time accounting (if latency::enabled()).
+  op_timing timing_;
+
+  // CPU time accounting (if cpu_account::enabled() at creation and Data is
+  // traced), linked to the account of the spawning operation.
+  std::shared_ptr<cpu_account> cpu_;
+
   std::mutex state_mutex_;
   bool running_;
   bool reschedule_;
@@ -89,4 +114,16 @@ operation<Data>* current_op() {
   return reinterpret_cast<operation<Data>*>(this_op);
 }
 
+// Operations created while a detached_spawn is alive are roots: they neither
+// inherit the current operation's cancel token nor its CPU account.
+// Must not span a suspension point.
+struct detached_spawn {
+  detached_spawn() : prev_{std::exchange(this_op, nullptr)} {}
+  detached_spawn(detached_spawn const&) = delete;
+  detached_spawn& operator=(detached_spawn const&) = delete;
+  ~detached_spawn() { this_op = prev_; }
+
+  void* prev_;
+};
+
 }  // namespace ctx
@@ -1,44 +1,148 @@
 #pragma once
 
-#include <atomic>
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <thread>
 #include <vector>
 
 #include "ctx/ctx.h"
 
 namespace ctx {
 
+// Automatic grain size: a few chunks per worker thread.
+constexpr auto const kAutoGrainSize = std::size_t{0U};
+
+namespace detail {
+
+// Children reference the caller's stack frame - wait for all of them,
+// even if the calling operation gets cancelled. Rethrows the first
+// exception, preferring real errors over operation_cancelled.
+template <typename Data, typename T>
+void join_all(std::vector<future_ptr<Data, T>> const& futures,
+              std::exception_ptr exception = nullptr) {
+  for (auto const& fut : futures) {
+    fut->join();
+  }
+
+  std::exception_ptr cancelled;
+  for (auto const& fut : futures) {
+    try {
+      fut->val();
+    } catch (operation_cancelled const&) {
+      if (!cancelled) {
+        cancelled = std::current_exception();
+      }
+    } catch (...) {
+      if (!exception) {
+        exception = std::current_exception();
+      }
+    }
+  }
+
+  if (exception) {
+    std::rethrow_exception(exception);
+  } else if (cancelled) {
+    std::rethrow_exception(cancelled);
+  }
+}
+
+inline std::size_t grain_size(std::size_t const size,
+                              std::size_t const requested) {
+  if (requested != kAutoGrainSize) {
+    return requested;
+  }
+  auto const threads = std::max(1U, std::thread::hardware_concurrency());
+  return std::max(std::size_t{1U}, size / (4U * threads));
+}
+
+// Recursive binary splitting: hand the upper half of [from, to) to a new
+// operation until the rest fits the grain size, then call chunk_fn(from, end)
+// on the remaining chunk. The first exception cancels the scope. A cancelled
+// scope throws operation_cancelled: the range was only partially processed.
+template <typename Data, typename ChunkFn, typename Scope>
+void parallel_chunks(std::size_t const from, std::size_t const to,
+                     std::size_t const grain, ChunkFn& chunk_fn, op_id id,
+                     Scope& scope) {
+  auto const op = current_op<Data>();
+  id.parent_index = op->id_.index;
+
+  std::vector<future_ptr<Data, void>> futures;
+  auto end = to;
+  while (end - from > grain && !scope.is_cancelled()) {
+    auto const mid = from + (end - from) / 2;
+    futures.push_back(op->sched_.post_void_work(
+        op->data_,
+        [mid, end, grain, &chunk_fn, id, &scope]() {
+          parallel_chunks<Data>(mid, end, grain, chunk_fn, id, scope);
+        },
+        id));
+    end = mid;
+  }
+
+  std::exception_ptr exception;
+  try {
+    if (!scope.is_cancelled()) {
+      chunk_fn(from, end);
+    }
+  } catch (...) {
+    scope.cancel();
+    exception = std::current_exception();
+  }
+
+  join_all<Data>(futures, exception);
+  if (scope.is_cancelled()) {
+    throw operation_cancelled{};
+  }
+}
+
+}  // namespace detail
+
+// One operation per element.
 template <typename Data, typename T, typename Fn>
 void parallel_for(T& vec, Fn fn, ctx::op_id id) {
   auto const op = ctx::current_op<Data>();
   id.parent_index = op->id_.index;
 
-  std::atomic_bool has_execption{false};
-  std::exception_ptr exception;
+  // The first failing element cancels the remaining ones:
+  // queued elements are dropped before they get a stack.
+  auto scope = cancel_scope<Data>{};
 
   std::vector<future_ptr<Data, void>> futures;
   for (auto& elem : vec) {
     auto wrapped = [&] {
-      if (has_execption) {
-        return;
+      try {
+        fn(elem);
+      } catch (...) {
+        scope.cancel();
+        throw;
       }
-      fn(elem);
     };
     futures.push_back(op->sched_.post_void_work(op->data_, wrapped, id));
   }
 
-  for (auto const& fut : futures) {
-    try {
-      fut->val();
-    } catch (std::exception const&) {
-      if (!has_execption.exchange(true)) {
-        exception = std::current_exception();
-      }
-    }
-  }
+  detail::join_all<Data>(futures);
+}
 
-  if (has_execption) {
-    std::rethrow_exception(exception);
+// One operation per chunk of (at most) grain_size elements.
+// Requires random access iterators.
+template <typename Data, typename T, typename Fn>
+void parallel_for(T& vec, Fn fn, ctx::op_id id, std::size_t const grain_size) {
+  auto const first = std::begin(vec);
+  auto const size =
+      static_cast<std::size_t>(std::distance(first, std::end(vec)));
+  if (size == 0U) {
+    return;
   }
+
+  auto scope = cancel_scope<Data>{};
+  auto chunk = [&](std::size_t const from, std::size_t const to) {
+    for (auto i = from; i != to && !scope.is_cancelled(); ++i) {
+      fn(first[i]);
+    }
+  };
+  detail::parallel_chunks<Data>(0U, size, detail::grain_size(size, grain_size),
+                                chunk, std::move(id), scope);
 }
 
 }  // namespace ctx
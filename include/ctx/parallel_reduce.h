@@ -0,0 +1,86 @@
+#pragma once
+
+#include <exception>
+#include <iterator>
+#include <vector>
+
+#include "ctx/parallel_for.h"
+
+namespace ctx {
+
+namespace detail {
+
+// Like parallel_chunks, but every operation returns the reduction of its
+// range: its own chunk first, then the upper halves in ascending order
+// (reduce only has to be associative, not commutative). Throws
+// operation_cancelled if the scope was cancelled.
+template <typename Data, typename T, typename It, typename Reduce,
+          typename Scope>
+T parallel_reduce_range(It const first, std::size_t const from,
+                        std::size_t const to, std::size_t const grain,
+                        Reduce& reduce, op_id id, Scope& scope) {
+  auto const op = current_op<Data>();
+  id.parent_index = op->id_.index;
+
+  std::vector<future_ptr<Data, T>> futures;
+  auto end = to;
+  while (end - from > grain && !scope.is_cancelled()) {
+    auto const mid = from + (end - from) / 2;
+    futures.push_back(op->sched_.post_work(
+        op->data_,
+        [first, mid, end, grain, &reduce, id, &scope]() {
+          return parallel_reduce_range<Data, T>(first, mid, end, grain, reduce,
+                                                id, scope);
+        },
+        id));
+    end = mid;
+  }
+
+  std::exception_ptr exception;
+  T partial{};
+  try {
+    if (!scope.is_cancelled()) {
+      partial = first[from];
+      for (auto i = from + 1U; i != end; ++i) {
+        partial = reduce(std::move(partial), first[i]);
+      }
+    }
+  } catch (...) {
+    scope.cancel();
+    exception = std::current_exception();
+  }
+
+  join_all<Data>(futures, exception);
+  if (scope.is_cancelled()) {
+    throw operation_cancelled{};  // never combine partial results
+  }
+
+  for (auto it = futures.rbegin(); it != futures.rend(); ++it) {
+    partial = reduce(std::move(partial), std::move((*it)->val()));
+  }
+  return partial;
+}
+
+}  // namespace detail
+
+// Returns reduce(init, reduce(vec[0], vec[1], ...)) computed with one partial
+// result per chunk. Requires random access iterators and an associative
+// reduce(T, T) -> T.
+template <typename Data, typename C, typename T, typename Reduce>
+T parallel_reduce(C const& vec, T init, Reduce reduce, op_id id,
+                  std::size_t const grain_size = kAutoGrainSize) {
+  auto const first = std::begin(vec);
+  auto const size =
+      static_cast<std::size_t>(std::distance(first, std::end(vec)));
+  if (size == 0U) {
+    return init;
+  }
+
+  auto scope = cancel_scope<Data>{};
+  return reduce(std::move(init),
+                detail::parallel_reduce_range<Data, T>(
+                    first, 0U, size, detail::grain_size(size, grain_size),
+                    reduce, std::move(id), scope));
+}
+
+}  // namespace ctx
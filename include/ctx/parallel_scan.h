@@ -0,0 +1,105 @@
+#pragma once
+
+#include <iterator>
+#include <optional>
+#include <vector>
+
+#include "utl/verify.h"
+
+#include "ctx/parallel_for.h"
+
+namespace ctx {
+
+namespace detail {
+
+// Three phases over fixed chunks of grain size:
+//   1. reduce every chunk (parallel)
+//   2. prefix over the chunk sums (sequential, one value per chunk)
+//   3. scan every chunk starting at its offset (parallel)
+// in and out may be the same range. Cancellation throws operation_cancelled
+// (from parallel_chunks) before the next phase starts.
+template <typename Data, typename T, typename In, typename Out, typename Op>
+void parallel_scan(In const& in, Out& out, std::optional<T> init, Op& op,
+                   bool const inclusive, op_id id,
+                   std::size_t const grain_size) {
+  auto const in_first = std::begin(in);
+  auto const out_first = std::begin(out);
+  auto const size =
+      static_cast<std::size_t>(std::distance(in_first, std::end(in)));
+  utl::verify(static_cast<std::size_t>(std::distance(
+                  out_first, std::end(out))) >= size,
+              "parallel_scan: output too small");
+  if (size == 0U) {
+    return;
+  }
+
+  auto const grain = detail::grain_size(size, grain_size);
+  auto const n_chunks = (size + grain - 1U) / grain;
+  auto const chunk_end = [&](std::size_t const c) {
+    return std::min(size, (c + 1U) * grain);
+  };
+
+  auto scope = cancel_scope<Data>{};
+
+  std::vector<T> sums(n_chunks);
+  auto reduce_chunks = [&](std::size_t const from, std::size_t const to) {
+    for (auto c = from; c != to && !scope.is_cancelled(); ++c) {
+      T sum = in_first[c * grain];
+      for (auto i = c * grain + 1U; i != chunk_end(c); ++i) {
+        sum = op(std::move(sum), in_first[i]);
+      }
+      sums[c] = std::move(sum);
+    }
+  };
+  parallel_chunks<Data>(0U, n_chunks, 1U, reduce_chunks, id, scope);
+
+  std::vector<std::optional<T>> offsets(n_chunks);
+  auto offset = std::move(init);
+  for (auto c = 0U; c != n_chunks; ++c) {
+    offsets[c] = offset;
+    offset = offset.has_value() ? op(std::move(*offset), sums[c]) : sums[c];
+  }
+
+  auto scan_chunks = [&](std::size_t const from, std::size_t const to) {
+    for (auto c = from; c != to && !scope.is_cancelled(); ++c) {
+      auto acc = std::move(offsets[c]);
+      for (auto i = c * grain; i != chunk_end(c); ++i) {
+        T val = in_first[i];
+        if (inclusive) {
+          acc = acc.has_value() ? op(std::move(*acc), std::move(val))
+                                : std::move(val);
+          out_first[i] = *acc;
+        } else {
+          out_first[i] = *acc;
+          acc = op(std::move(*acc), std::move(val));
+        }
+      }
+    }
+  };
+  parallel_chunks<Data>(0U, n_chunks, 1U, scan_chunks, std::move(id), scope);
+}
+
+template <typename C>
+using value_t =
+    typename std::iterator_traits<decltype(std::begin(std::declval<C&>()))>::
+        value_type;
+
+}  // namespace detail
+
+// out[i] = in[0] op in[1] op ... op in[i]
+template <typename Data, typename In, typename Out, typename Op>
+void parallel_inclusive_scan(In const& in, Out& out, Op op, op_id id,
+                             std::size_t const grain_size = kAutoGrainSize) {
+  detail::parallel_scan<Data, detail::value_t<In const>>(
+      in, out, std::nullopt, op, true, std::move(id), grain_size);
+}
+
+// out[i] = init op in[0] op ... op in[i - 1]
+template <typename Data, typename In, typename Out, typename T, typename Op>
+void parallel_exclusive_scan(In const& in, Out& out, T init, Op op, op_id id,
+                             std::size_t const grain_size = kAutoGrainSize) {
+  detail::parallel_scan<Data, T>(in, out, std::optional<T>{std::move(init)},
+                                 op, false, std::move(id), grain_size);
+}
+
+}  // namespace ctx
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#include "ctx/parallel_for.h"
+
+namespace ctx {
+
+// Below this, automatic grain sizes are not worth an operation.
+constexpr auto const kMinAutoSortGrainSize = std::size_t{2048U};
+
+namespace detail {
+
+// Merge sort: sort both halves in parallel, merge sequentially.
+template <typename Data, typename It, typename Cmp>
+void parallel_sort_range(It const first, It const last,
+                         std::size_t const grain, Cmp& cmp, op_id id) {
+  auto const size = static_cast<std::size_t>(std::distance(first, last));
+  if (size <= grain) {
+    std::sort(first, last, cmp);
+    return;
+  }
+
+  auto const op = current_op<Data>();
+  id.parent_index = op->id_.index;
+
+  auto const mid = first + size / 2U;
+  auto const upper = op->sched_.post_void_work(
+      op->data_,
+      [mid, last, grain, &cmp, id]() {
+        parallel_sort_range<Data>(mid, last, grain, cmp, id);
+      },
+      id);
+
+  std::exception_ptr exception;
+  try {
+    parallel_sort_range<Data>(first, mid, grain, cmp, id);
+  } catch (...) {
+    exception = std::current_exception();
+  }
+  join_all<Data>(std::vector<future_ptr<Data, void>>{upper}, exception);
+
+  std::inplace_merge(first, mid, last, cmp);
+}
+
+}  // namespace detail
+
+// Requires random access iterators.
+template <typename Data, typename C, typename Cmp>
+void parallel_sort(C& vec, Cmp cmp, op_id id,
+                   std::size_t const grain_size = kAutoGrainSize) {
+  auto const first = std::begin(vec);
+  auto const last = std::end(vec);
+  auto const size = static_cast<std::size_t>(std::distance(first, last));
+  auto const grain =
+      grain_size == kAutoGrainSize
+          ? std::max(detail::grain_size(size, grain_size),
+                     kMinAutoSortGrainSize)
+          : grain_size;
+  detail::parallel_sort_range<Data>(first, last, grain, cmp, std::move(id));
+}
+
+template <typename Data, typename C>
+void parallel_sort(C& vec, op_id id) {
+  parallel_sort<Data>(vec, std::less<>{}, std::move(id));
+}
+
+}  // namespace ctx
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <iterator>
+
+#include "utl/verify.h"
+
+#include "ctx/parallel_for.h"
+
+namespace ctx {
+
+// out[i] = fn(in[i]) for all elements, chunked like parallel_for.
+// out has to be at least as large as in. Throws operation_cancelled if
+// cancelled (out is then only partially written).
+template <typename Data, typename In, typename Out, typename Fn>
+void parallel_transform(In const& in, Out& out, Fn fn, op_id id,
+                        std::size_t const grain_size = kAutoGrainSize) {
+  auto const in_first = std::begin(in);
+  auto const out_first = std::begin(out);
+  auto const size =
+      static_cast<std::size_t>(std::distance(in_first, std::end(in)));
+  utl::verify(static_cast<std::size_t>(std::distance(
+                  out_first, std::end(out))) >= size,
+              "parallel_transform: output too small");
+  if (size == 0U) {
+    return;
+  }
+
+  auto scope = cancel_scope<Data>{};
+  auto chunk = [&](std::size_t const from, std::size_t const to) {
+    for (auto i = from; i != to && !scope.is_cancelled(); ++i) {
+      out_first[i] = fn(in_first[i]);
+    }
+  };
+  detail::parallel_chunks<Data>(0U, size, detail::grain_size(size, grain_size),
+                                chunk, std::move(id), scope);
+}
+
+}  // namespace ctx
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+#include "ctx/thread_local.h"
+
+namespace ctx {
+
+// Fiber-aware sampling profiler (POSIX: SIGPROF / ITIMER_PROF).
+//
+// Each sample records the operation running on the interrupted thread
+// (op_id::created_at) and the return addresses of its frames up to the
+// fiber entry (operation::start): the walk never crosses into the fcontext
+// trampoline. Samples taken outside of operations (runner, idle spinning)
+// are attributed to "[scheduler]" with the interrupted function only.
+//
+// write_folded() emits the folded stack format of flamegraph.pl /
+// speedscope / inferno ("op;outer;...;inner count"), one flame graph
+// root per operation call site.
+//
+// The signal handler only copies the frame pointer chain into a
+// preallocated sample buffer (async-signal-safe); symbolization happens
+// in write_folded(). Compile with -fno-omit-frame-pointer: functions
+// without frame pointers are missing from the stacks. Supported on Linux
+// x86-64 / aarch64 and macOS x86-64 (elsewhere: operation names only).
+namespace profiler {
+
+// The identity of the operation running on this thread (nullptr if none).
+// Set by operation<Data>::resume() around the switch into the fiber.
+struct fiber {
+  char const* name_;
+  void const* stack_begin_;  // lowest address
+  void const* stack_end_;  // frame of operation::start() (empty before)
+};
+
+extern CTX_ATTRIBUTE_TLS fiber const* this_fiber;
+
+// Starts sampling every `interval` of consumed CPU time (all threads).
+// Previous samples are kept (see clear()). Returns false if already running
+// or not supported on this platform.
+bool start(std::chrono::microseconds interval = std::chrono::milliseconds{1});
+
+void stop();
+
+bool running();
+
+// Discards all samples. Call while stopped.
+void clear();
+
+// Samples not recorded because the sample buffer was full.
+std::uint64_t dropped();
+
+// Aggregated folded stacks with symbolized frames. Call while stopped.
+void write_folded(std::ostream&);
+
+}  // namespace profiler
+
+}  // namespace ctx
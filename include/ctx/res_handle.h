@@ -0,0 +1,22 @@
+#pragma once
+
+#include "ctx/res_id_t.h"
+
+namespace ctx {
+
+// Typed access to a resource, resolved once when access is granted.
+// Non-owning: valid while the access_scheduler::mutex it was obtained from
+// is held (i.e. for the duration of the operation's function).
+template <typename T>
+struct res_handle {
+  T& operator*() const { return *ptr_; }
+  T* operator->() const { return ptr_; }
+  T* get() const { return ptr_; }
+
+  res_id_t id() const { return id_; }
+
+  T* ptr_{nullptr};
+  res_id_t id_{0U};
+};
+
+}  // namespace ctx
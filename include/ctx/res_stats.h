@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ctx/duration_histogram.h"
+
+namespace ctx {
+
+// Contention statistics of one access_scheduler resource.
+struct res_stats {
+  std::uint64_t read_acquisitions_{0U};
+  std::uint64_t write_acquisitions_{0U};
+  std::uint64_t intent_acquisitions_{0U};  // hierarchical resources
+  std::uint64_t upgrades_{0U};  // READ -> WRITE (counted as write as well)
+
+  std::uint64_t contended_{0U};  // acquisitions that had to queue
+  std::uint64_t upgrade_waits_{0U};
+  std::uint64_t max_queue_length_{0U};  // all queues, including the waiter
+
+  std::uint64_t combined_batches_{0U};  // write combining
+  std::uint64_t combined_writes_{0U};
+
+  duration_histogram wait_time_;  // queued until granted (contended only)
+  duration_histogram hold_time_;  // granted until released
+};
+
+}  // namespace ctx
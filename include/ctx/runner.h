@@ -7,17 +7,34 @@
 #include "boost/asio/io_service.hpp"
 
 #include "ctx/concurrent_stack.h"
+#include "ctx/thread_local.h"
 
 namespace ctx {
 
+// Index of the runner worker thread executing the caller.
+extern CTX_ATTRIBUTE_TLS unsigned this_worker;
+
 struct runner {
+  static constexpr auto const kNoWorker =
+      concurrent_stack<std::function<void()>>::kNoWorker;
+
+  // kNoWorker if not called from a worker thread (e.g. the io_service).
+  static unsigned current_worker() { return this_worker; }
+
   void stop() { ios_.stop(); }
 
   boost::asio::io_service& ios() { return ios_; }
 
+  concurrent_stack<std::function<void()>>::stats work_stats() {
+    return work_stack_.get_stats();
+  }
+
+  // Posted and not yet finished (queued or executing).
+  std::size_t elements_in_system() const { return elements_in_system_; }
+
   void run(unsigned thread_count, bool quit_on_ios_exit = false) {
     ios_.reset();
-    work_stack_.reset();
+    work_stack_.reset(thread_count);
 
     auto work_guard = boost::asio::make_work_guard(ios_);
     if (quit_on_ios_exit) {
@@ -25,10 +42,11 @@ struct runner {
     }
 
     std::vector<std::thread> workers{thread_count};
-    for (auto& w : workers) {
-      w = std::thread([&]() {
+    for (auto i = 0U; i != thread_count; ++i) {
+      workers[i] = std::thread([&, i]() {
+        this_worker = i;
         while (true) {
-          if (auto f = work_stack_.poll(); f.has_value()) {
+          if (auto f = work_stack_.poll(i); f.has_value()) {
             (*f)();
             if (--elements_in_system_ == 0ul) {
               work_guard.reset();
@@ -77,6 +95,14 @@ struct runner {
     work_stack_.push_bottom(std::forward<Fn>(f));
   }
 
+  // Soft affinity: preferably executed by the given worker, stolen by others
+  // if it is busy (high priority otherwise).
+  template <typename Fn>
+  void post_affine(unsigned const worker, Fn&& f) {
+    ++elements_in_system_;
+    work_stack_.push_affine(worker, std::forward<Fn>(f));
+  }
+
   boost::asio::io_service ios_;
 
 private:
@@ -4,6 +4,7 @@
 #include <memory>
 
 #include "ctx/future.h"
+#include "ctx/metrics.h"
 #include "ctx/op_id.h"
 #include "ctx/runner.h"
 #include "ctx/stack_manager.h"
@@ -18,6 +19,9 @@ struct scheduler {
 
   void run(unsigned num_threads) { runner_.run(num_threads); }
 
+  // Snapshot of the runtime counters (callable while running).
+  ctx::metrics metrics();
+
   unsigned next_op_id() { return ++next_id_; }
 
   template <typename Fn>
@@ -38,9 +42,14 @@ struct scheduler {
   void enqueue_work(Data, std::function<void()>, op_id);
   void enqueue_work(std::shared_ptr<operation<Data>> const&);
 
+  // Prefer running on the given runner worker (see runner::post_affine).
+  void enqueue_work(Data, std::function<void()>, op_id, unsigned worker);
+  void enqueue_work(std::shared_ptr<operation<Data>> const&, unsigned worker);
+
   std::atomic<unsigned> next_id_ = 0;
   runner runner_;
   stack_manager stack_manager_;
+  op_counters op_counters_;
 };
 
 }  // namespace ctx
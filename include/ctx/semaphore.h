@@ -0,0 +1,68 @@
+#pragma once
+
+#include <mutex>
+
+#include "ctx/cancel_token.h"
+#include "ctx/wait_queue.h"
+
+namespace ctx {
+
+// Counting semaphore for operations. Waiters are served in FIFO order:
+// a large acquire at the front is not overtaken by smaller ones.
+template <typename Data>
+struct semaphore {
+  explicit semaphore(std::size_t const count) : count_{count} {}
+
+  semaphore(semaphore const&) = delete;
+  semaphore& operator=(semaphore const&) = delete;
+
+  void acquire(std::size_t const n = 1U) {
+    auto l = std::unique_lock{mutex_};
+    if (waiters_.empty() && count_ >= n) {
+      count_ -= n;
+      return;
+    }
+
+    auto w = typename wait_queue<Data>::waiter{n};
+    if (!waiters_.wait(l, w)) {
+      auto wakeups = typename wait_queue<Data>::wakeups_t{};
+      dispatch(wakeups);
+      l.unlock();
+      wait_queue<Data>::wake(wakeups);
+      throw operation_cancelled{};
+    }
+  }
+
+  bool try_acquire(std::size_t const n = 1U) {
+    auto const l = std::lock_guard{mutex_};
+    if (!waiters_.empty() || count_ < n) {
+      return false;
+    }
+    count_ -= n;
+    return true;
+  }
+
+  void release(std::size_t const n = 1U) {
+    auto wakeups = typename wait_queue<Data>::wakeups_t{};
+    {
+      auto const l = std::lock_guard{mutex_};
+      count_ += n;
+      dispatch(wakeups);
+    }
+    wait_queue<Data>::wake(wakeups);
+  }
+
+private:
+  void dispatch(typename wait_queue<Data>::wakeups_t& wakeups) {
+    while (!waiters_.empty() && count_ >= waiters_.front().n_) {
+      count_ -= waiters_.front().n_;
+      waiters_.grant_front(wakeups);
+    }
+  }
+
+  std::mutex mutex_;
+  wait_queue<Data> waiters_;
+  std::size_t count_;
+};
+
+}  // namespace ctx
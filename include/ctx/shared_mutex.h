@@ -0,0 +1,108 @@
+#pragma once
+
+#include <mutex>
+
+#include "ctx/cancel_token.h"
+#include "ctx/wait_queue.h"
+
+namespace ctx {
+
+// Reader/writer mutex for operations with FIFO fairness: a waiting writer
+// blocks readers arriving after it. Releases admit the next writer or all
+// consecutive readers at the front of the queue at once.
+// Works with std::unique_lock / std::shared_lock.
+template <typename Data>
+struct shared_mutex {
+  shared_mutex() = default;
+  shared_mutex(shared_mutex const&) = delete;
+  shared_mutex& operator=(shared_mutex const&) = delete;
+
+  void lock() { acquire(kExclusive); }
+  void lock_shared() { acquire(kShared); }
+
+  bool try_lock() {
+    auto const l = std::lock_guard{mutex_};
+    if (writer_ || readers_ != 0U || !waiters_.empty()) {
+      return false;
+    }
+    writer_ = true;
+    return true;
+  }
+
+  bool try_lock_shared() {
+    auto const l = std::lock_guard{mutex_};
+    if (writer_ || !waiters_.empty()) {
+      return false;
+    }
+    ++readers_;
+    return true;
+  }
+
+  void unlock() {
+    auto wakeups = typename wait_queue<Data>::wakeups_t{};
+    {
+      auto const l = std::lock_guard{mutex_};
+      writer_ = false;
+      dispatch(wakeups);
+    }
+    wait_queue<Data>::wake(wakeups);
+  }
+
+  void unlock_shared() {
+    auto wakeups = typename wait_queue<Data>::wakeups_t{};
+    {
+      auto const l = std::lock_guard{mutex_};
+      --readers_;
+      dispatch(wakeups);
+    }
+    wait_queue<Data>::wake(wakeups);
+  }
+
+private:
+  static constexpr auto const kShared = std::size_t{0U};
+  static constexpr auto const kExclusive = std::size_t{1U};
+
+  bool can_grant(std::size_t const mode) const {
+    return mode == kShared ? !writer_ : !writer_ && readers_ == 0U;
+  }
+
+  void grant(std::size_t const mode) {
+    if (mode == kShared) {
+      ++readers_;
+    } else {
+      writer_ = true;
+    }
+  }
+
+  void acquire(std::size_t const mode) {
+    auto l = std::unique_lock{mutex_};
+    if (waiters_.empty() && can_grant(mode)) {
+      grant(mode);
+      return;
+    }
+
+    auto w = typename wait_queue<Data>::waiter{mode};
+    if (!waiters_.wait(l, w)) {
+      // We might have blocked the waiters behind us.
+      auto wakeups = typename wait_queue<Data>::wakeups_t{};
+      dispatch(wakeups);
+      l.unlock();
+      wait_queue<Data>::wake(wakeups);
+      throw operation_cancelled{};
+    }
+  }
+
+  void dispatch(typename wait_queue<Data>::wakeups_t& wakeups) {
+    while (!waiters_.empty() && can_grant(waiters_.front().n_)) {
+      grant(waiters_.front().n_);
+      waiters_.grant_front(wakeups);
+    }
+  }
+
+  std::mutex mutex_;
+  wait_queue<Data> waiters_;
+  std::size_t readers_{0U};
+  bool writer_{false};
+};
+
+}  // namespace ctx
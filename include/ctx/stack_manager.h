@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <cstdlib>
 #include <mutex>
 #include <vector>
@@ -44,6 +46,11 @@ struct stack_manager {
     node* next_{nullptr};
   } list_{};
   std::mutex list_mutex_;
+
+  std::atomic<std::uint64_t> allocated_{0U};  // malloc'd
+  std::atomic<std::uint64_t> reused_{0U};  // taken from list_
+  std::atomic<std::uint64_t> released_{0U};
+  std::atomic<std::uint64_t> pooled_{0U};  // in list_
 };
 
 }  // namespace ctx
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+
+#include "ctx/op_id.h"
+#include "ctx/transition.h"
+
+namespace ctx {
+
+// Low overhead tracing of operation transitions.
+//
+// Every thread records into its own ring buffer (no locks, no allocation
+// on the recording path; the oldest events are overwritten). The buffers
+// can be exported as Chrome Trace Event JSON (chrome://tracing, Perfetto):
+// ACTIVATE..DEACTIVATE/FIN become slices on the executing thread,
+// ENQUEUE / SUSPEND / RESUME instant events, and a flow arrow links the
+// enqueueing thread to the first activation of each operation.
+//
+// Recording happens where Data::transition forwards to trace::record,
+// with trace::tracer as Data::tracer or trace_data as Data base class.
+namespace trace {
+
+struct event {
+  std::uint64_t ts_ns_;
+  char const* name_;  // op_id::created_at (static storage)
+  unsigned index_;
+  unsigned parent_index_;
+  unsigned callee_index_;
+  transition t_;
+};
+
+struct buffer {
+  static constexpr auto const kCapacity = std::size_t{1U} << 16U;
+
+  void push(event const& e) {
+    auto const pos = next_.load(std::memory_order_relaxed);
+    events_[pos & (kCapacity - 1U)] = e;
+    next_.store(pos + 1U, std::memory_order_release);
+  }
+
+  std::unique_ptr<event[]> events_{new event[kCapacity]};
+  std::atomic<std::uint64_t> next_{0U};
+  unsigned thread_id_{0U};
+};
+
+// The calling thread's buffer (registered on first use).
+buffer& thread_buffer();
+
+extern std::atomic_bool enabled_flag;
+
+inline void enable(bool const on = true) { enabled_flag = on; }
+inline bool enabled() { return enabled_flag.load(std::memory_order_relaxed); }
+
+inline void record(transition const t, op_id const& id, op_id const& callee) {
+  if (!enabled()) {
+    return;
+  }
+  auto const now = std::chrono::steady_clock::now().time_since_epoch();
+  thread_buffer().push(event{
+      static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()),
+      id.created_at, id.index, id.parent_index, callee.index, t});
+}
+
+// Discards all recorded events.
+void clear();
+
+// Writes all buffers as Chrome Trace Event JSON. Call while the scheduler is
+// idle: events recorded concurrently may be torn.
+void write_chrome_json(std::ostream&);
+
+}  // namespace trace
+
+namespace trace {
+
+// Tracer (see tracer.h) recording all transitions.
+struct tracer {
+  template <typename Data>
+  static void transition(Data&, ctx::transition const t, op_id const& id,
+                         op_id const& callee) {
+    record(t, id, callee);
+  }
+};
+
+}  // namespace trace
+
+// Data base class recording all transitions.
+struct trace_data {
+  using tracer = trace::tracer;
+};
+
+}  // namespace ctx
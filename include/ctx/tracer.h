@@ -0,0 +1,37 @@
+#pragma once
+
+#include <type_traits>
+
+namespace ctx {
+
+// Compile-time instrumentation policy of scheduler<Data>, selected by
+// declaring `using tracer = ...;` in Data (or specializing tracer_for for
+// Data types that cannot declare it, e.g. pointers):
+//
+//  - data_tracer (default): built-in accounting (op_latency, cpu_account;
+//    switched on at runtime) and Data::transition(transition, op_id, op_id)
+//  - no_tracer: transitions compile to nothing (Data::transition is not
+//    required and never called, no accounting)
+//  - custom: built-in accounting and
+//    static void T::transition(Data&, transition, op_id const& id,
+//                              op_id const& callee)
+struct data_tracer {};
+struct no_tracer {};
+
+template <typename Data, typename = void>
+struct tracer_for {
+  using type = data_tracer;
+};
+
+template <typename Data>
+struct tracer_for<Data, std::void_t<typename Data::tracer>> {
+  using type = typename Data::tracer;
+};
+
+template <typename Data>
+using tracer_t = typename tracer_for<Data>::type;
+
+template <typename Data>
+constexpr auto const is_traced_v = !std::is_same_v<tracer_t<Data>, no_tracer>;
+
+}  // namespace ctx
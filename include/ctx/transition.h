@@ -0,0 +1,7 @@
+#pragma once
+
+namespace ctx {
+
+enum class transition { RESUME, SUSPEND, ENQUEUE, ACTIVATE, DEACTIVATE, FIN };
+
+}  // namespace ctx
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace ctx {
+
+// Read-copy-update resource for read-mostly data.
+//
+// Readers pin the current version (one atomic shared_ptr load) and never
+// block: neither on each other nor on writers. Writers publish a complete
+// new version; operations that pinned an older one keep using it. A version
+// is reclaimed when the last reader pinning it releases it.
+//
+// Writers are serialized among themselves (update() is read-copy-update),
+// but never wait for readers.
+//
+// Stored in an access_scheduler with emplace_versioned(), readers do not
+// need to request access to it at all: they keep the returned
+// versioned_ptr and pin() through it.
+template <typename T>
+struct versioned {
+  explicit versioned(T initial)
+      : current_{std::make_shared<T const>(std::move(initial))} {}
+
+  versioned(versioned const&) = delete;
+  versioned& operator=(versioned const&) = delete;
+
+  versioned(versioned&& o) noexcept
+      : current_{std::atomic_load(&o.current_)},
+        version_{o.version_.load()} {}
+  versioned& operator=(versioned&&) = delete;
+
+  std::shared_ptr<T const> pin() const { return std::atomic_load(&current_); }
+
+  void publish(T next) {
+    auto const lock = std::lock_guard{write_mutex_};
+    store(std::move(next));
+  }
+
+  // Publishes a modified copy of the current version: fn(T&).
+  template <typename Fn>
+  void update(Fn&& fn) {
+    auto const lock = std::lock_guard{write_mutex_};
+    auto next = T{*std::atomic_load(&current_)};
+    fn(next);
+    store(std::move(next));
+  }
+
+  // Number of versions published so far.
+  std::uint64_t version() const { return version_.load(); }
+
+private:
+  void store(T&& next) {
+    std::atomic_store(&current_,
+                      std::shared_ptr<T const>{
+                          std::make_shared<T const>(std::move(next))});
+    ++version_;
+  }
+
+  std::shared_ptr<T const> current_;
+  std::atomic<std::uint64_t> version_{0U};
+  std::mutex write_mutex_;
+};
+
+template <typename T>
+using versioned_ptr = std::shared_ptr<versioned<T>>;
+
+}  // namespace ctx
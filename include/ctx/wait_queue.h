@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ctx/operation.h"
+
+namespace ctx {
+
+// FIFO of suspended operations for the synchronization primitives.
+// The primitive decides (under its own lock) which waiters are granted;
+// a granted waiter owns what it waited for when it resumes (direct hand-off,
+// no retry), so spurious wakeups only re-check the granted flag.
+template <typename Data>
+struct wait_queue {
+  struct waiter {
+    explicit waiter(std::size_t const n = 1U)
+        : op_{current_op<Data>()}, n_{n} {}
+
+    operation<Data>* op_;
+    std::size_t n_;  // primitive specific: units, exclusive/shared, ...
+    bool granted_{false};
+  };
+
+  using wakeups_t = std::vector<std::shared_ptr<operation<Data>>>;
+
+  // Enqueues w and suspends until it is granted.
+  // The lock is held on entry and on exit.
+  // Returns false (with w removed) if the operation got cancelled first.
+  bool wait(std::unique_lock<std::mutex>& l, waiter& w) {
+    waiters_.push_back(&w);
+    while (!w.granted_) {
+      if (w.op_->is_cancelled()) {
+        waiters_.erase(std::find(begin(waiters_), end(waiters_), &w));
+        return false;
+      }
+      l.unlock();
+      w.op_->suspend(/* finished = */ false);
+      l.lock();
+    }
+    return true;
+  }
+
+  bool empty() const { return waiters_.empty(); }
+  waiter& front() { return *waiters_.front(); }
+
+  void grant_front(wakeups_t& wakeups) {
+    auto const w = waiters_.front();
+    waiters_.pop_front();
+    w->granted_ = true;
+    wakeups.emplace_back(w->op_->shared_from_this());
+  }
+
+  void grant_all(wakeups_t& wakeups) {
+    while (!empty()) {
+      grant_front(wakeups);
+    }
+  }
+
+  // Call after releasing the primitive's lock.
+  static void wake(wakeups_t const& wakeups) {
+    for (auto const& op : wakeups) {
+      op->sched_.enqueue_work(op);
+    }
+  }
+
+private:
+  std::deque<waiter*> waiters_;
+};
+
+}  // namespace ctx
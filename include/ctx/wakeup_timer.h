@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+
+#include "boost/asio/steady_timer.hpp"
+
+#include "ctx/operation.h"
+
+namespace ctx {
+
+using deadline_t = std::chrono::steady_clock::time_point;
+
+constexpr auto const kNoDeadline = deadline_t::max();
+
+struct operation_timeout : public std::exception {
+  char const* what() const noexcept override { return "operation timed out"; }
+};
+
+// Resumes the current operation at the deadline (on the runner's io_service)
+// unless the timer is destroyed before. Waiting code has to tolerate the
+// resulting spurious wakeup and check expired().
+template <typename Data>
+struct wakeup_timer {
+  explicit wakeup_timer(deadline_t const deadline)
+      : expired_{std::make_shared<std::atomic_bool>(false)},
+        timer_{current_op<Data>()->sched_.runner_.ios(), deadline} {
+    timer_.async_wait([expired = expired_,
+                       w = current_op<Data>()->weak_from_this()](
+                          boost::system::error_code const& ec) {
+      if (ec) {
+        return;
+      }
+      expired->store(true);
+      if (auto const op = w.lock(); op) {
+        op->sched_.enqueue_work(op);
+      }
+    });
+  }
+
+  wakeup_timer(wakeup_timer const&) = delete;
+  wakeup_timer(wakeup_timer&&) = delete;
+  wakeup_timer& operator=(wakeup_timer const&) = delete;
+  wakeup_timer& operator=(wakeup_timer&&) = delete;
+
+  ~wakeup_timer() = default;
+
+  bool expired() const { return expired_->load(); }
+
+private:
+  std::shared_ptr<std::atomic_bool> expired_;
+  boost::asio::steady_timer timer_;
+};
+
+}  // namespace ctx
@@ -0,0 +1,61 @@
+#include "ctx/cancel_token.h"
+
+#include <algorithm>
+
+namespace ctx {
+
+std::shared_ptr<cancel_token> cancel_token::make(cancel_token* parent) {
+  auto token = std::make_shared<cancel_token>();
+  if (parent != nullptr) {
+    parent->add_child(token);
+  }
+  return token;
+}
+
+void cancel_token::cancel() {
+  std::function<void()> wake;
+  std::vector<std::weak_ptr<cancel_token>> children;
+  {
+    auto const lock = std::lock_guard{mutex_};
+    if (cancelled_.exchange(true)) {
+      return;
+    }
+    wake = std::move(wake_);
+    children = std::move(children_);
+  }
+
+  for (auto const& c : children) {
+    if (auto const child = c.lock(); child) {
+      child->cancel();
+    }
+  }
+
+  if (wake) {
+    wake();
+  }
+}
+
+void cancel_token::set_waker(std::function<void()> wake) {
+  auto const lock = std::lock_guard{mutex_};
+  if (!cancelled_) {
+    wake_ = std::move(wake);
+  }
+}
+
+void cancel_token::add_child(std::shared_ptr<cancel_token> const& child) {
+  auto const lock = std::lock_guard{mutex_};
+  if (cancelled_) {
+    child->cancelled_ = true;
+    return;
+  }
+
+  // Drop finished children before growing (long-lived parents).
+  if (children_.size() >= 64U && children_.size() == children_.capacity()) {
+    children_.erase(std::remove_if(begin(children_), end(children_),
+                                   [](auto const& c) { return c.expired(); }),
+                    end(children_));
+  }
+  children_.emplace_back(child);
+}
+
+}  // namespace ctx
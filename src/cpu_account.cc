@@ -0,0 +1,51 @@
+#include "ctx/cpu_account.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <ctime>
+#endif
+
+namespace ctx {
+
+std::atomic_bool cpu_account::enabled_flag{false};
+
+std::shared_ptr<cpu_account> cpu_account::make(
+    std::shared_ptr<cpu_account> const& parent) {
+  if (!enabled()) {
+    return nullptr;
+  }
+  auto account = std::make_shared<cpu_account>();
+  account->parent_ = parent;
+  return account;
+}
+
+std::chrono::nanoseconds cpu_account::thread_time() {
+#ifdef _WIN32
+  FILETIME creation, exit, kernel, user;
+  GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+  auto const to_100ns = [](FILETIME const& t) {
+    return (static_cast<std::int64_t>(t.dwHighDateTime) << 32U) |
+           t.dwLowDateTime;
+  };
+  return std::chrono::nanoseconds{(to_100ns(kernel) + to_100ns(user)) * 100};
+#else
+  timespec ts{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return std::chrono::seconds{ts.tv_sec} + std::chrono::nanoseconds{ts.tv_nsec};
+#endif
+}
+
+void cpu_account::stop() {
+  if (started_.count() == 0) {
+    return;  // never activated
+  }
+  auto const ns = (thread_time() - started_).count();
+  started_ = std::chrono::nanoseconds{0};
+  self_ns_.fetch_add(ns, std::memory_order_relaxed);
+  for (auto a = this; a != nullptr; a = a->parent_.get()) {
+    a->tree_ns_.fetch_add(ns, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace ctx
@@ -1,7 +1,10 @@
+#include <limits>
+
 #include "ctx/thread_local.h"
 
 namespace ctx {
 
 CTX_ATTRIBUTE_TLS void* this_op = nullptr;
+CTX_ATTRIBUTE_TLS unsigned this_worker = std::numeric_limits<unsigned>::max();
 
 }  // namespace ctx
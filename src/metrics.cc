@@ -0,0 +1,68 @@
+#include "ctx/metrics.h"
+
+#include <ostream>
+
+namespace ctx {
+
+namespace {
+
+void write_metric(std::ostream& out, std::string_view const prefix,
+                  char const* name, char const* type, char const* help,
+                  std::uint64_t const value) {
+  out << "# HELP " << prefix << name << ' ' << help << '\n'
+      << "# TYPE " << prefix << name << ' ' << type << '\n'
+      << prefix << name << ' ' << value << '\n';
+}
+
+}  // namespace
+
+void write_prometheus(std::ostream& out, metrics const& m,
+                      std::string_view const prefix) {
+  auto const counter = [&](char const* name, char const* help,
+                           std::uint64_t const value) {
+    write_metric(out, prefix, name, "counter", help, value);
+  };
+  auto const gauge = [&](char const* name, char const* help,
+                         std::uint64_t const value) {
+    write_metric(out, prefix, name, "gauge", help, value);
+  };
+
+  counter("ops_created_total", "Operations created.", m.ops_created_);
+  counter("ops_started_total", "Operations activated for the first time.",
+          m.ops_started_);
+  counter("ops_finished_total", "Operations finished.", m.ops_finished_);
+  counter("context_switches_total", "Switches into an operation.",
+          m.context_switches_);
+  counter("ops_resumed_total", "Activations after a suspension.",
+          m.ops_resumed_);
+
+  counter("tasks_posted_total", "Tasks posted to the runner.",
+          m.tasks_posted_);
+  counter("tasks_executed_total", "Tasks taken by runner workers.",
+          m.tasks_executed_);
+  counter("affine_tasks_executed_total",
+          "Affine tasks taken by their preferred worker.",
+          m.affine_tasks_executed_);
+  counter("steals_total", "Affine tasks taken by another worker.",
+          m.steals_);
+  counter("worker_waits_total", "Times a worker blocked on an empty queue.",
+          m.worker_waits_);
+  gauge("queue_depth", "Tasks queued in the runner.", m.queue_depth_);
+  gauge("tasks_in_system", "Tasks queued or executing.", m.tasks_in_system_);
+  gauge("workers", "Runner worker threads.", m.workers_);
+  gauge("idle_workers", "Workers blocked on an empty queue.",
+        m.idle_workers_);
+
+  counter("stacks_allocated_total", "Fiber stacks allocated.",
+          m.stacks_allocated_);
+  counter("stacks_reused_total", "Fiber stacks taken from the pool.",
+          m.stacks_reused_);
+  counter("stacks_released_total", "Fiber stacks released.",
+          m.stacks_released_);
+  gauge("stacks_pooled", "Fiber stacks in the pool.", m.stacks_pooled_);
+  gauge("stacks_in_use", "Fiber stacks in use.", m.stacks_in_use_);
+  gauge("stack_bytes", "Memory held by fiber stacks (in use + pooled).",
+        m.stack_bytes_);
+}
+
+}  // namespace ctx
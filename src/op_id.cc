@@ -0,0 +1,59 @@
+#include "ctx/op_id.h"
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace ctx {
+
+namespace {
+
+struct name_table {
+  name_table() { intern("unknown"); }
+
+  op_name_t intern(std::string_view const name) {
+    {
+      auto const lock = std::shared_lock{mutex_};
+      if (auto const it = ids_.find(name); it != end(ids_)) {
+        return it->second;
+      }
+    }
+
+    auto const lock = std::unique_lock{mutex_};
+    if (auto const it = ids_.find(name); it != end(ids_)) {
+      return it->second;
+    }
+    auto const id = static_cast<op_name_t>(names_.size());
+    auto const& stored = names_.emplace_back(name);  // deque: stable
+    ids_.emplace(stored, id);
+    return id;
+  }
+
+  char const* get(op_name_t const id) {
+    auto const lock = std::shared_lock{mutex_};
+    return id < names_.size() ? names_[id].c_str() : names_.front().c_str();
+  }
+
+  std::shared_mutex mutex_;
+  std::deque<std::string> names_;
+  std::unordered_map<std::string_view, op_name_t> ids_;
+};
+
+name_table& get_name_table() {
+  static auto t = new name_table{};  // leaked: used by exiting threads
+  return *t;
+}
+
+}  // namespace
+
+op_name_t intern_op_name(std::string_view const name) {
+  return get_name_table().intern(name);
+}
+
+char const* op_name_str(op_name_t const name) {
+  return get_name_table().get(name);
+}
+
+}  // namespace ctx
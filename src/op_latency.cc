@@ -0,0 +1,109 @@
+#include "ctx/op_latency.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace ctx::latency {
+
+std::atomic_bool enabled_flag{false};
+
+namespace {
+
+// Per thread: uncontended except for snapshot() / reset().
+struct collector {
+  std::mutex mutex_;
+  std::unordered_map<char const*, op_latency> sites_;
+};
+
+struct registry {
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<collector>> collectors_;
+  std::vector<collector*> free_;
+};
+
+registry& get_registry() {
+  static auto r = new registry{};  // leaked: used by exiting threads
+  return *r;
+}
+
+struct thread_collector_holder {
+  thread_collector_holder() {
+    auto& r = get_registry();
+    auto const lock = std::lock_guard{r.mutex_};
+    if (r.free_.empty()) {
+      c_ = r.collectors_.emplace_back(std::make_unique<collector>()).get();
+    } else {
+      c_ = r.free_.back();
+      r.free_.pop_back();
+    }
+  }
+
+  ~thread_collector_holder() {
+    auto& r = get_registry();
+    auto const lock = std::lock_guard{r.mutex_};
+    r.free_.push_back(c_);
+  }
+
+  thread_collector_holder(thread_collector_holder const&) = delete;
+  thread_collector_holder& operator=(thread_collector_holder const&) = delete;
+
+  collector* c_;
+};
+
+collector& thread_collector() {
+  thread_local auto holder = thread_collector_holder{};
+  return *holder.c_;
+}
+
+}  // namespace
+
+void record(op_id const& id, std::chrono::nanoseconds const queue,
+            std::chrono::nanoseconds const run,
+            std::chrono::nanoseconds const suspended,
+            cpu_account const* cpu) {
+  auto& c = thread_collector();
+  auto const lock = std::lock_guard{c.mutex_};
+  auto& site = c.sites_[id.created_at];
+  if (site.name_.empty()) {
+    site.name_ = id.name_str();
+  }
+  site.queue_time_.add(queue);
+  site.run_time_.add(run);
+  site.suspended_time_.add(suspended);
+  if (cpu != nullptr) {
+    site.cpu_time_.add(cpu->self_time());
+  }
+}
+
+std::map<std::string, op_latency> snapshot() {
+  auto& r = get_registry();
+  auto const registry_lock = std::lock_guard{r.mutex_};
+  auto merged = std::map<std::string, op_latency>{};
+  for (auto const& c : r.collectors_) {
+    auto const lock = std::lock_guard{c->mutex_};
+    for (auto const& [created_at, site] : c->sites_) {
+      auto& m = merged[created_at == nullptr ? "unknown" : created_at];
+      if (m.name_.empty()) {
+        m.name_ = site.name_;
+      }
+      m.queue_time_.merge(site.queue_time_);
+      m.run_time_.merge(site.run_time_);
+      m.suspended_time_.merge(site.suspended_time_);
+      m.cpu_time_.merge(site.cpu_time_);
+    }
+  }
+  return merged;
+}
+
+void reset() {
+  auto& r = get_registry();
+  auto const registry_lock = std::lock_guard{r.mutex_};
+  for (auto const& c : r.collectors_) {
+    auto const lock = std::lock_guard{c->mutex_};
+    c->sites_.clear();
+  }
+}
+
+}  // namespace ctx::latency
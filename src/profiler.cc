@@ -0,0 +1,237 @@
+#include "ctx/profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#endif
+
+namespace ctx::profiler {
+
+CTX_ATTRIBUTE_TLS fiber const* this_fiber = nullptr;
+
+namespace {
+
+constexpr auto const kMaxDepth = 64U;
+constexpr auto const kMaxSamples = std::size_t{1U} << 16U;
+
+struct sample {
+  char const* name_;
+  unsigned depth_;
+  std::uintptr_t pcs_[kMaxDepth];  // innermost first, return addresses
+};
+
+std::unique_ptr<sample[]> samples;
+std::atomic<std::size_t> next_sample{0U};
+std::atomic<std::uint64_t> dropped_samples{0U};
+std::atomic_bool is_running{false};
+
+#ifndef _WIN32
+struct sigaction previous_action;
+
+struct registers {
+  std::uintptr_t pc_, sp_, fp_;
+};
+
+// Registers of the interrupted code (false: unsupported platform).
+bool get_registers(void const* context, registers& r) {
+  auto const uc = static_cast<ucontext_t const*>(context);
+#if defined(__linux__) && defined(__x86_64__)
+  auto const& gregs = uc->uc_mcontext.gregs;
+  r = {static_cast<std::uintptr_t>(gregs[REG_RIP]),
+       static_cast<std::uintptr_t>(gregs[REG_RSP]),
+       static_cast<std::uintptr_t>(gregs[REG_RBP])};
+  return true;
+#elif defined(__linux__) && defined(__aarch64__)
+  r = {uc->uc_mcontext.pc, uc->uc_mcontext.sp, uc->uc_mcontext.regs[29]};
+  return true;
+#elif defined(__APPLE__) && defined(__x86_64__)
+  auto const& ss = uc->uc_mcontext->__ss;
+  r = {ss.__rip, ss.__rsp, ss.__rbp};
+  return true;
+#else
+  (void)uc;
+  (void)r;
+  return false;
+#endif
+}
+
+// Async-signal-safe: reads the frame pointer chain (saved frame pointer,
+// return address) of the interrupted fiber without leaving [sp, end), where
+// end is the frame of operation::start(). Frames beyond (fcontext entry and
+// trampoline) are never touched.
+void walk_fiber(registers const& r, fiber const& f, sample& s) {
+  auto const end = reinterpret_cast<std::uintptr_t>(f.stack_end_);
+  if (r.sp_ < reinterpret_cast<std::uintptr_t>(f.stack_begin_) ||
+      r.sp_ >= end) {
+    return;  // still / already on the scheduler stack (switching)
+  }
+
+  // symbolize() looks up pc - 1 (return addresses point behind the call).
+  s.pcs_[s.depth_++] = r.pc_ + 1U;
+
+  auto fp = r.fp_;
+  while (s.depth_ != kMaxDepth && fp >= r.sp_ && fp < end &&
+         fp % alignof(std::uintptr_t) == 0U) {
+    auto const frame = reinterpret_cast<std::uintptr_t const*>(fp);
+    auto const next = frame[0];
+    auto const ret = frame[1];
+    if (ret == 0U || next <= fp) {
+      break;
+    }
+    s.pcs_[s.depth_++] = ret;
+    fp = next;
+  }
+}
+
+void on_signal(int, siginfo_t*, void* context) {
+  auto const idx = next_sample.fetch_add(1U, std::memory_order_relaxed);
+  if (idx >= kMaxSamples) {
+    ++dropped_samples;
+    return;
+  }
+
+  auto const f = this_fiber;
+  auto& s = samples[idx];
+  s.name_ = f == nullptr ? nullptr : f->name_;
+  s.depth_ = 0U;
+
+  auto r = registers{};
+  if (!get_registers(context, r)) {
+    return;
+  }
+  if (f == nullptr) {
+    s.pcs_[s.depth_++] = r.pc_ + 1U;  // unknown stack bounds: leaf only
+  } else {
+    walk_fiber(r, *f, s);
+  }
+}
+
+// ';' separates frames, the line ends with the count.
+std::string sanitize(std::string s) {
+  for (auto& c : s) {
+    if (c == ';' || c == '\n') {
+      c = ' ';
+    }
+  }
+  return s;
+}
+
+std::string symbolize(std::uintptr_t const pc) {
+  Dl_info info{};
+  // Return addresses point behind the call: look up pc - 1.
+  if (dladdr(reinterpret_cast<void*>(pc - 1U), &info) == 0 ||
+      info.dli_sname == nullptr) {
+    auto buf = std::array<char, 2U + 2U * sizeof(pc) + 1U>{};
+    std::snprintf(buf.data(), buf.size(), "0x%zx", static_cast<size_t>(pc));
+    return buf.data();
+  }
+
+  auto status = 0;
+  auto const demangled = std::unique_ptr<char, void (*)(void*)>{
+      abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status),
+      std::free};
+  return sanitize(status == 0 ? demangled.get() : info.dli_sname);
+}
+#endif
+
+}  // namespace
+
+bool start(std::chrono::microseconds const interval) {
+#ifdef _WIN32
+  (void)interval;
+  return false;
+#else
+  if (is_running || interval.count() <= 0) {
+    return false;
+  }
+
+  if (samples == nullptr) {
+    samples.reset(new sample[kMaxSamples]);
+  }
+
+  struct sigaction action {};
+  action.sa_sigaction = on_signal;
+  action.sa_flags = SA_RESTART | SA_SIGINFO;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, &previous_action) != 0) {
+    return false;
+  }
+
+  auto timer = itimerval{};
+  timer.it_interval.tv_sec = static_cast<time_t>(interval.count() / 1000000);
+  timer.it_interval.tv_usec =
+      static_cast<suseconds_t>(interval.count() % 1000000);
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+    sigaction(SIGPROF, &previous_action, nullptr);
+    return false;
+  }
+
+  is_running = true;
+  return true;
+#endif
+}
+
+void stop() {
+#ifndef _WIN32
+  if (!is_running) {
+    return;
+  }
+  auto timer = itimerval{};
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  sigaction(SIGPROF, &previous_action, nullptr);
+  is_running = false;
+#endif
+}
+
+bool running() { return is_running; }
+
+void clear() {
+  next_sample = 0U;
+  dropped_samples = 0U;
+}
+
+std::uint64_t dropped() { return dropped_samples; }
+
+void write_folded(std::ostream& out) {
+#ifndef _WIN32
+  auto const n = std::min(next_sample.load(), kMaxSamples);
+  auto symbols = std::map<std::uintptr_t, std::string>{};
+  auto stacks = std::map<std::string, std::uint64_t>{};
+  for (auto i = std::size_t{0U}; i != n; ++i) {
+    auto const& s = samples[i];
+    auto stack = s.name_ == nullptr ? "[scheduler]" : sanitize(s.name_);
+    for (auto d = s.depth_; d != 0U; --d) {
+      auto const pc = s.pcs_[d - 1U];
+      auto it = symbols.find(pc);
+      if (it == end(symbols)) {
+        it = symbols.emplace(pc, symbolize(pc)).first;
+      }
+      stack += ';';
+      stack += it->second;
+    }
+    ++stacks[stack];
+  }
+  for (auto const& [stack, count] : stacks) {
+    out << stack << ' ' << count << '\n';
+  }
+#else
+  (void)out;
+#endif
+}
+
+}  // namespace ctx::profiler
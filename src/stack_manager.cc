@@ -41,6 +41,8 @@ stack_handle stack_manager::alloc() {
   {
     auto const lock = std::lock_guard{list_mutex_};
     if (list_.next_ != nullptr) {
+      reused_.fetch_add(1U, std::memory_order_relaxed);
+      pooled_.fetch_sub(1U, std::memory_order_relaxed);
       stack_handle s(list_.take());
 #ifdef CTX_ENABLE_VALGRIND
       s.id = VALGRIND_STACK_REGISTER(s.get_stack(), s.get_stack_end());
@@ -50,6 +52,7 @@ stack_handle stack_manager::alloc() {
   }
 #endif
 
+  allocated_.fetch_add(1U, std::memory_order_relaxed);
   stack_handle s(allocate(kStackSize));
 #ifdef CTX_ENABLE_VALGRIND
   s.id = VALGRIND_STACK_REGISTER(s.get_stack(), s.get_stack_end());
@@ -58,9 +61,11 @@ stack_handle stack_manager::alloc() {
 }
 
 void stack_manager::dealloc(stack_handle& s) {
+  released_.fetch_add(1U, std::memory_order_relaxed);
 #ifndef CTX_ENABLE_ASAN
   auto const lock = std::lock_guard{list_mutex_};
   list_.push(s.get_allocated_mem());
+  pooled_.fetch_add(1U, std::memory_order_relaxed);
 #else
   std::free(s.get_allocated_mem());
 #endif
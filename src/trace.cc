@@ -0,0 +1,183 @@
+#include "ctx/trace.h"
+
+#include <algorithm>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace ctx::trace {
+
+std::atomic_bool enabled_flag{false};
+
+namespace {
+
+struct registry {
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<buffer>> buffers_;
+  std::vector<buffer*> free_;
+};
+
+registry& get_registry() {
+  static auto r = new registry{};  // leaked: used by exiting threads
+  return *r;
+}
+
+// Returns the buffer to the pool when its thread exits. Events stay
+// recorded until clear().
+struct thread_buffer_holder {
+  thread_buffer_holder() {
+    auto& r = get_registry();
+    auto const lock = std::lock_guard{r.mutex_};
+    if (r.free_.empty()) {
+      buf_ = r.buffers_.emplace_back(std::make_unique<buffer>()).get();
+      buf_->thread_id_ = static_cast<unsigned>(r.buffers_.size());
+    } else {
+      buf_ = r.free_.back();
+      r.free_.pop_back();
+    }
+  }
+
+  ~thread_buffer_holder() {
+    auto& r = get_registry();
+    auto const lock = std::lock_guard{r.mutex_};
+    r.free_.push_back(buf_);
+  }
+
+  thread_buffer_holder(thread_buffer_holder const&) = delete;
+  thread_buffer_holder& operator=(thread_buffer_holder const&) = delete;
+
+  buffer* buf_;
+};
+
+void write_string(std::ostream& out, char const* s) {
+  out << '"';
+  for (; s != nullptr && *s != '\0'; ++s) {
+    switch (*s) {
+      case '"': out << "\\\""; break;
+      case '\\': out << "\\\\"; break;
+      case '\n': out << "\\n"; break;
+      case '\t': out << "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(*s) < 0x20U) {
+          out << ' ';
+        } else {
+          out << *s;
+        }
+    }
+  }
+  out << '"';
+}
+
+void write_ts(std::ostream& out, std::uint64_t const ts_ns) {
+  auto const fraction = ts_ns % 1000U;
+  out << ts_ns / 1000U << '.' << (fraction < 100U ? "0" : "")
+      << (fraction < 10U ? "0" : "") << fraction;
+}
+
+}  // namespace
+
+buffer& thread_buffer() {
+  thread_local auto holder = thread_buffer_holder{};
+  return *holder.buf_;
+}
+
+void clear() {
+  auto& r = get_registry();
+  auto const lock = std::lock_guard{r.mutex_};
+  for (auto& b : r.buffers_) {
+    b->next_.store(0U, std::memory_order_relaxed);
+  }
+}
+
+void write_chrome_json(std::ostream& out) {
+  auto& r = get_registry();
+  auto const lock = std::lock_guard{r.mutex_};
+
+  auto events = std::vector<std::pair<unsigned, event>>{};
+  for (auto const& b : r.buffers_) {
+    auto const end = b->next_.load(std::memory_order_acquire);
+    auto const begin = end > buffer::kCapacity ? end - buffer::kCapacity : 0U;
+    for (auto i = begin; i != end; ++i) {
+      events.emplace_back(b->thread_id_,
+                          b->events_[i & (buffer::kCapacity - 1U)]);
+    }
+  }
+  std::stable_sort(begin(events), end(events),
+                   [](auto const& a, auto const& b) {
+                     return a.second.ts_ns_ < b.second.ts_ns_;
+                   });
+
+  // Slices must nest: only emit "E" for operations with an open "B" on the
+  // same thread (the ring may have dropped the begin).
+  auto open = std::vector<std::pair<unsigned, unsigned>>{};  // (tid, op)
+  auto activated = std::vector<unsigned>{};
+
+  auto first = true;
+  auto const write_event = [&](char const* ph, char const* name,
+                               unsigned const tid, event const& e) {
+    out << (first ? "\n" : ",\n") << "{\"name\":";
+    write_string(out, name);
+    out << ",\"cat\":\"op\",\"ph\":\"" << ph << "\",\"pid\":1,\"tid\":" << tid
+        << ",\"ts\":";
+    write_ts(out, e.ts_ns_);
+    first = false;
+  };
+  auto const op_name = [](event const& e) {
+    return e.name_ == nullptr ? "unknown" : e.name_;
+  };
+  auto const write_instant = [&](char const* name, unsigned const tid,
+                                 event const& e) {
+    write_event("i", name, tid, e);
+    out << ",\"s\":\"t\",\"args\":{\"name\":";
+    write_string(out, op_name(e));
+    out << ",\"op\":" << e.index_ << ",\"parent\":" << e.parent_index_
+        << ",\"callee\":" << e.callee_index_ << "}}";
+  };
+
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  for (auto const& [tid, e] : events) {
+    switch (e.t_) {
+      case transition::ACTIVATE: {
+        write_event("B", op_name(e), tid, e);
+        out << ",\"args\":{\"op\":" << e.index_
+            << ",\"parent\":" << e.parent_index_ << "}}";
+        open.emplace_back(tid, e.index_);
+        if (auto const it = std::lower_bound(begin(activated), end(activated),
+                                             e.index_);
+            it == end(activated) || *it != e.index_) {
+          activated.insert(it, e.index_);
+          write_event("f", "enqueue", tid, e);
+          out << ",\"bp\":\"e\",\"id\":" << e.index_ << "}";
+        }
+        break;
+      }
+
+      case transition::DEACTIVATE:
+      case transition::FIN: {
+        auto const it =
+            std::find(begin(open), end(open), std::pair{tid, e.index_});
+        if (it != end(open)) {
+          open.erase(it);
+          write_event("E", op_name(e), tid, e);
+          out << "}";
+        }
+        if (e.t_ == transition::FIN) {
+          write_instant("finish", tid, e);
+        }
+        break;
+      }
+
+      case transition::ENQUEUE:
+        write_instant("enqueue", tid, e);
+        write_event("s", "enqueue", tid, e);
+        out << ",\"id\":" << e.index_ << "}";
+        break;
+
+      case transition::SUSPEND: write_instant("suspend", tid, e); break;
+      case transition::RESUME: write_instant("resume", tid, e); break;
+    }
+  }
+  out << "\n]}\n";
+}
+
+}  // namespace ctx::trace